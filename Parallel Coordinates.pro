@@ -2,6 +2,9 @@
 # Automatically generated by qmake (2.01a) Wed 8. Aug 10:18:29 2012
 ######################################################################
 CONFIG += console
+QT += network
+LIBS += -lz
+unix:!macx:LIBS += -lrt
 TEMPLATE = app
 TARGET = 
 DEPENDPATH += . src
@@ -9,14 +12,50 @@ INCLUDEPATH += .
 
 # Input
 HEADERS += src/ParallelCoordinates.h \
+           src/ParallelCoordsAxisOrdering.h \
+           src/ParallelCoordsClipper.h \
+           src/ParallelCoordsClustering.h \
+           src/ParallelCoordsColumnCodec.h \
+           src/ParallelCoordsDataSnapshot.h \
+           src/ParallelCoordsDiskCache.h \
+           src/ParallelCoordsFilter.h \
+           src/ParallelCoordsLoader.h \
+           src/ParallelCoordsPickIndex.h \
+           src/ParallelCoordsPngWriter.h \
+           src/ParallelCoordsPosterExport.h \
+           src/ParallelCoordsProjection.h \
+           src/ParallelCoordsPublished.h \
+           src/ParallelCoordsRaster.h \
            src/ParallelCoordsRenderManager.h \
+           src/ParallelCoordsRenderService.h \
            src/ParallelCoordsViewPrivate.h \
            src/ParallelCoordsRenderThread.h \
+           src/ParallelCoordsReplay.h \
+           src/ParallelCoordsShmLayout.h \
+           src/ParallelCoordsTileServer.h \
+           src/ParallelCoordsTrace.h \
            src/ParallelCoordsVisualizer.h \
            src/QParallelCoordsData.h \
            src/QParallelCoordsWidget.h
-SOURCES += src/ParallelCoordsRenderManager.cpp \
+SOURCES += src/ParallelCoordsAxisOrdering.cpp \
+           src/ParallelCoordsClipper.cpp \
+           src/ParallelCoordsClustering.cpp \
+           src/ParallelCoordsColumnCodec.cpp \
+           src/ParallelCoordsDataSnapshot.cpp \
+           src/ParallelCoordsDiskCache.cpp \
+           src/ParallelCoordsFilter.cpp \
+           src/ParallelCoordsLoader.cpp \
+           src/ParallelCoordsPickIndex.cpp \
+           src/ParallelCoordsPngWriter.cpp \
+           src/ParallelCoordsPosterExport.cpp \
+           src/ParallelCoordsProjection.cpp \
+           src/ParallelCoordsRaster.cpp \
+           src/ParallelCoordsRenderManager.cpp \
+           src/ParallelCoordsRenderService.cpp \
            src/ParallelCoordsRenderThread.cpp \
+           src/ParallelCoordsReplay.cpp \
+           src/ParallelCoordsTileServer.cpp \
+           src/ParallelCoordsTrace.cpp \
            src/ParallelCoordsVisualizer.cpp \
            src/QParallelCoordsData.cpp \
            src/QParallelCoordsWidget.cpp
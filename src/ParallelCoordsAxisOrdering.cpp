@@ -0,0 +1,325 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsAxisOrdering.h"
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+// Columns are standardized into blocks of this height before the
+// pairwise products are taken, so both operands of a dot product
+// stay in L1 while the axis tile is swept
+const int rowBlockSize = 1024;
+const int axisTileSize = 32;
+
+struct rowRange {
+	int begin;
+	int end;
+};
+
+// Mean and sum of squared deviations from it per axis, kept apart
+// so columns far from zero (time stamps, ids) keep their spread
+struct momentSums {
+	QVector<double> mean;
+	QVector<double> m2;
+	QVector<double> count;		// values present per axis
+};
+
+struct productSums {
+	QVector<double> sum;	// upper triangle of a row major matrix
+};
+
+}
+
+static float dotBlock(float const *a, float const *b, int n)
+{
+	int i = 0;
+	float s = 0;
+#ifdef __SSE__
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for(; i+8 <= n; i += 8) {
+		acc0 = _mm_add_ps(acc0,
+			_mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+		acc1 = _mm_add_ps(acc1,
+			_mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	s = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for(; i<n; i++)
+		s += a[i] * b[i];
+	return s;
+}
+
+static momentSums computeMoments(rowRange range,
+	ParallelCoordsDataSnapshot const *data)
+{
+	const int axisCnt = data->axis_count();
+	momentSums m;
+	m.mean.fill(0.0, axisCnt);
+	m.m2.fill(0.0, axisCnt);
+	m.count.fill(0.0, axisCnt);
+
+	// collapsed duplicates count as often as they were read
+	QVector<qreal> buffer;
+	QVector<quint32> weightBuffer;
+	const int n = range.end - range.begin;
+	quint32 const *weights = data->weightChunk(range.begin, n, weightBuffer);
+	for(int j=0; j<axisCnt; j++) {
+		qreal const *col = data->columnChunk(j, range.begin, n, buffer);
+		// Welford's update, weighted
+		double mean = 0, m2 = 0, c = 0;
+		for(int i=0; i<n; i++) {
+			if(qIsNaN(col[i]))
+				continue;
+			const double w = weights ? weights[i] : 1;
+			const double d = col[i] - mean;
+			c += w;
+			mean += d * w / c;
+			m2 += w * d * (col[i] - mean);
+		}
+		m.mean[j] = mean;
+		m.m2[j] = m2;
+		m.count[j] = c;
+	}
+	return m;
+}
+
+static void reduceMoments(momentSums &result, momentSums const& partial)
+{
+	if(result.mean.isEmpty()) {
+		result = partial;
+		return;
+	}
+	// Pairwise merge of two partial means and squared deviations
+	for(int j=0; j<result.mean.count(); j++) {
+		const double ca = result.count[j], cb = partial.count[j];
+		const double c = ca + cb;
+		if(cb == 0)
+			continue;
+		const double d = partial.mean[j] - result.mean[j];
+		result.mean[j] += d * cb / c;
+		result.m2[j] += partial.m2[j] + d * d * ca * cb / c;
+		result.count[j] = c;
+	}
+}
+
+static productSums computeProducts(rowRange range,
+	ParallelCoordsDataSnapshot const *data,
+	QVector<qreal> const *mean,
+	QVector<qreal> const *invStd)
+{
+	const int axisCnt = data->axis_count();
+	productSums p;
+	p.sum.fill(0.0, axisCnt * axisCnt);
+
+	// column major block of standardized values
+	QVector<float> z(axisCnt * rowBlockSize);
+	float *zp = z.data();
+	QVector<qreal> buffer;
+	QVector<quint32> weightBuffer;
+	QVector<float> rootWeights(rowBlockSize);
+
+	for(int blockStart=range.begin; blockStart<range.end;
+		blockStart += rowBlockSize) {
+		const int n = qMin(rowBlockSize, range.end - blockStart);
+
+		// Both sides of a product carry the root of the weight, so a
+		// collapsed row adds weight times its product
+		quint32 const *weights = data->weightChunk(blockStart, n, weightBuffer);
+		for(int r=0; weights && r<n; r++)
+			rootWeights[r] = std::sqrt(static_cast<float>(weights[r]));
+
+		for(int j=0; j<axisCnt; j++) {
+			qreal const *col = data->columnChunk(j, blockStart, n, buffer);
+			const qreal m = (*mean)[j];
+			const qreal s = (*invStd)[j];
+			float *zcol = zp + j*rowBlockSize;
+			// missing values sit at the mean and add nothing
+			for(int r=0; r<n; r++)
+				zcol[r] = qIsNaN(col[r]) ? 0.0f : (col[r] - m) * s;
+			for(int r=0; weights && r<n; r++)
+				zcol[r] *= rootWeights[r];
+		}
+
+		for(int ti=0; ti<axisCnt; ti+=axisTileSize) {
+			const int tiEnd = qMin(ti + axisTileSize, axisCnt);
+			for(int tj=ti; tj<axisCnt; tj+=axisTileSize) {
+				const int tjEnd = qMin(tj + axisTileSize, axisCnt);
+				for(int a=ti; a<tiEnd; a++) {
+					for(int b=qMax(a, tj); b<tjEnd; b++) {
+						p.sum[a*axisCnt + b] +=
+							dotBlock(zp + a*rowBlockSize, zp + b*rowBlockSize, n);
+					}
+				}
+			}
+		}
+	}
+	return p;
+}
+
+static void reduceProducts(productSums &result, productSums const& partial)
+{
+	if(result.sum.isEmpty()) {
+		result = partial;
+		return;
+	}
+	for(int k=0; k<result.sum.count(); k++)
+		result.sum[k] += partial.sum[k];
+}
+
+ParallelCoordsAxisOrdering::ParallelCoordsAxisOrdering(
+	QParallelCoordsData const *data_)
+: data(data_->snapshot())
+{
+	maxImprovementPasses = 50;
+}
+
+QVector<qreal> ParallelCoordsAxisOrdering::correlationMatrix() const
+{
+	const int axisCnt = data->axis_count();
+	const int dataLength = data->length();
+	QVector<qreal> corr(qMax(axisCnt, 0) * qMax(axisCnt, 0), 0.0);
+	if(axisCnt <= 0 || dataLength <= 1)
+		return corr;
+
+	// Split the rows into a few ranges per core, each range is
+	// reduced to partial sums that are then added together. Ranges
+	// are whole blocks so no block straddles two segments of the data.
+	QList<rowRange> ranges;
+	{
+		int rangeCnt = QThread::idealThreadCount() * 4;
+		int rangeLength = qMax(rowBlockSize,
+			(dataLength + rangeCnt - 1) / rangeCnt);
+		rangeLength = (rangeLength + rowBlockSize - 1) / rowBlockSize * rowBlockSize;
+		for(int i=0; i<dataLength; i+=rangeLength) {
+			rowRange r = {i, qMin(i + rangeLength, dataLength)};
+			ranges.push_back(r);
+		}
+	}
+
+	using namespace std::placeholders;
+	momentSums moments = QtConcurrent::blockingMappedReduced<momentSums>(
+		ranges, std::bind(computeMoments, _1, data.data()), reduceMoments);
+
+	QVector<qreal> mean(axisCnt), invStd(axisCnt);
+	for(int j=0; j<axisCnt; j++) {
+		const qreal n = qMax(moments.count[j], 1.0);
+		mean[j] = moments.mean[j];
+		qreal var = moments.m2[j] / n;
+		// constant axes correlate with nothing
+		invStd[j] = var > 0 ? 1.0 / std::sqrt(var) : 0.0;
+	}
+
+	productSums products = QtConcurrent::blockingMappedReduced<productSums>(
+		ranges, std::bind(computeProducts, _1, data.data(), &mean, &invStd),
+		reduceProducts);
+
+	const qreal rowCnt = data->weightedLength();
+	for(int a=0; a<axisCnt; a++) {
+		for(int b=a; b<axisCnt; b++) {
+			qreal c = products.sum[a*axisCnt + b] / rowCnt;
+			c = qBound(-1.0, c, 1.0);
+			corr[a*axisCnt + b] = corr[b*axisCnt + a] = c;
+		}
+	}
+	return corr;
+}
+
+QVector<int> ParallelCoordsAxisOrdering::order() const
+{
+	return order(correlationMatrix());
+}
+
+QVector<int> ParallelCoordsAxisOrdering::order(QVector<qreal> const& corr) const
+{
+	// Both strong positive and strong negative correlations give
+	// readable patterns between neighbouring axes so the absolute
+	// value is maximized along the chain
+	const int axisCnt = data->axis_count();
+	QVector<int> chain;
+	if(axisCnt <= 2) {
+		for(int i=0; i<axisCnt; i++)
+			chain.push_back(i);
+		return chain;
+	}
+
+	auto weight = [&](int a, int b) { return qAbs(corr[a*axisCnt + b]); };
+
+	// seed the chain with the most correlated pair
+	int seedA = 0, seedB = 1;
+	for(int a=0; a<axisCnt; a++) {
+		for(int b=a+1; b<axisCnt; b++) {
+			if(weight(a, b) > weight(seedA, seedB)) {
+				seedA = a;
+				seedB = b;
+			}
+		}
+	}
+
+	QVector<bool> used(axisCnt, false);
+	chain.push_back(seedA);
+	chain.push_back(seedB);
+	used[seedA] = used[seedB] = true;
+
+	// grow at whichever end has the best unused neighbour
+	while(chain.count() < axisCnt) {
+		int bestAxis = -1;
+		bool atFront = false;
+		qreal best = -1;
+		for(int c=0; c<axisCnt; c++) {
+			if(used[c])
+				continue;
+			if(weight(chain.front(), c) > best) {
+				best = weight(chain.front(), c);
+				bestAxis = c;
+				atFront = true;
+			}
+			if(weight(chain.back(), c) > best) {
+				best = weight(chain.back(), c);
+				bestAxis = c;
+				atFront = false;
+			}
+		}
+		if(atFront)
+			chain.push_front(bestAxis);
+		else
+			chain.push_back(bestAxis);
+		used[bestAxis] = true;
+	}
+
+	// 2-opt: reversing chain[i+1..j] swaps edges (i,i+1),(j,j+1)
+	// for (i,j),(i+1,j+1). Keep going while that helps.
+	for(int pass=0; pass<maxImprovementPasses; pass++) {
+		bool improved = false;
+		for(int i=0; i<axisCnt-2; i++) {
+			for(int j=i+2; j<axisCnt; j++) {
+				qreal before = weight(chain[i], chain[i+1]);
+				qreal after = weight(chain[i], chain[j]);
+				if(j+1 < axisCnt) {
+					before += weight(chain[j], chain[j+1]);
+					after += weight(chain[i+1], chain[j+1]);
+				}
+				if(after > before + 1e-9) {
+					std::reverse(chain.begin() + i + 1, chain.begin() + j + 1);
+					improved = true;
+				}
+			}
+		}
+		if(!improved)
+			break;
+	}
+
+	return chain;
+}
+
+QVector<int> ParallelCoordsAxisOrdering::computeOrder(
+	QParallelCoordsData const *data)
+{
+	return ParallelCoordsAxisOrdering(data).order();
+}
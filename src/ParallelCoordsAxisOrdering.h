@@ -0,0 +1,28 @@
+#ifndef __PARALLELCOORDSAXISORDERING_H__
+#define __PARALLELCOORDSAXISORDERING_H__
+
+#include "ParallelCoordinates.h"
+#include "QParallelCoordsData.h"
+
+// Finds an axis order that places strongly correlated axes next to
+// each other. The correlation matrix is computed over blocks of rows
+// on all cores, the order is then a greedy chain improved by 2-opt.
+// Works on the data as it was when constructed.
+class ParallelCoordsAxisOrdering
+{
+public:
+	ParallelCoordsAxisOrdering(QParallelCoordsData const *data);
+
+	// axis_count() x axis_count() row major matrix of pearson coefficients
+	QVector<qreal> correlationMatrix() const;
+	QVector<int> order() const;
+	QVector<int> order(QVector<qreal> const& corr) const;
+
+	static QVector<int> computeOrder(QParallelCoordsData const *data);
+
+private:
+	ParallelCoordsDataSnapshot::pointer data;
+	int maxImprovementPasses;
+};
+
+#endif
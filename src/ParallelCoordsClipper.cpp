@@ -0,0 +1,178 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsClipper.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The cut of one pair of axes by the rectangle, shared by every run
+// of rows clipped
+struct pairCut {
+	qreal t0;
+	qreal t1;
+	qreal x0;
+	qreal x1;
+	qreal top;
+	qreal bottom;
+	qreal const *yl;
+	qreal const *yr;
+	QLineF *out;
+	int *rows;
+};
+
+// Index of the lowest set bit of a word that is not 0
+inline int lowestBit(quint64 word)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	int b = 0;
+	for(; !(word & 1); word >>= 1)
+		b++;
+	return b;
+#endif
+}
+
+// Clips rows i to end-1 and appends what is left to out after cnt
+// lines, returns the new count
+int clipRows(pairCut const& c, int i, int end, int cnt)
+{
+	const qreal t0 = c.t0, t1 = c.t1, x0 = c.x0, x1 = c.x1;
+	const qreal top = c.top, bottom = c.bottom;
+	qreal const *yl = c.yl;
+	qreal const *yr = c.yr;
+	QLineF *out = c.out;
+	int *rows = c.rows;
+	const int n = end;
+
+#if defined(__SSE2__)
+	if(sizeof(qreal) == sizeof(double)) {
+		double const *l = reinterpret_cast<double const*>(yl);
+		double const *r = reinterpret_cast<double const*>(yr);
+		const __m128d vt0 = _mm_set1_pd(t0);
+		const __m128d vt1 = _mm_set1_pd(t1);
+		const __m128d vx0 = _mm_set1_pd(x0);
+		const __m128d vdx = _mm_set1_pd(x1 - x0);
+		const __m128d vtop = _mm_set1_pd(top);
+		const __m128d vbottom = _mm_set1_pd(bottom);
+		const __m128d zero = _mm_setzero_pd();
+		const __m128d one = _mm_set1_pd(1.0);
+
+		for(; i+2 <= n; i += 2) {
+			__m128d a = _mm_loadu_pd(l+i);
+			__m128d b = _mm_loadu_pd(r+i);
+			__m128d d = _mm_sub_pd(b, a);
+			__m128d y0 = _mm_add_pd(a, _mm_mul_pd(d, vt0));
+			__m128d y1 = _mm_add_pd(a, _mm_mul_pd(d, vt1));
+
+			// keep what has no NaN end and is not entirely
+			// above or below
+			__m128d keep = _mm_and_pd(_mm_cmpord_pd(y0, y1),
+				_mm_and_pd(
+					_mm_cmpge_pd(_mm_max_pd(y0, y1), vtop),
+					_mm_cmple_pd(_mm_min_pd(y0, y1), vbottom)));
+			int mask = _mm_movemask_pd(keep);
+			if(!mask)
+				continue;
+
+			// parameters where each end crosses the top or bottom,
+			// lanes that need no cut keep 0 and 1
+			__m128d dy = _mm_sub_pd(y1, y0);
+			__m128d tTop = _mm_div_pd(_mm_sub_pd(vtop, y0), dy);
+			__m128d tBottom = _mm_div_pd(_mm_sub_pd(vbottom, y0), dy);
+			__m128d startAbove = _mm_cmplt_pd(y0, vtop);
+			__m128d startBelow = _mm_cmpgt_pd(y0, vbottom);
+			__m128d endAbove = _mm_cmplt_pd(y1, vtop);
+			__m128d endBelow = _mm_cmpgt_pd(y1, vbottom);
+			__m128d s = _mm_or_pd(_mm_and_pd(startAbove, tTop),
+				_mm_or_pd(_mm_and_pd(startBelow, tBottom),
+					_mm_andnot_pd(_mm_or_pd(startAbove, startBelow), zero)));
+			__m128d e = _mm_or_pd(_mm_and_pd(endAbove, tTop),
+				_mm_or_pd(_mm_and_pd(endBelow, tBottom),
+					_mm_andnot_pd(_mm_or_pd(endAbove, endBelow), one)));
+
+			double px0[2], py0[2], px1[2], py1[2];
+			_mm_storeu_pd(px0, _mm_add_pd(vx0, _mm_mul_pd(vdx, s)));
+			_mm_storeu_pd(py0, _mm_add_pd(y0, _mm_mul_pd(dy, s)));
+			_mm_storeu_pd(px1, _mm_add_pd(vx0, _mm_mul_pd(vdx, e)));
+			_mm_storeu_pd(py1, _mm_add_pd(y0, _mm_mul_pd(dy, e)));
+			if(mask & 1) {
+				if(rows)
+					rows[cnt] = i;
+				out[cnt++] = QLineF(px0[0], py0[0], px1[0], py1[0]);
+			}
+			if(mask & 2) {
+				if(rows)
+					rows[cnt] = i+1;
+				out[cnt++] = QLineF(px0[1], py0[1], px1[1], py1[1]);
+			}
+		}
+	}
+#endif
+
+	for(; i<n; i++) {
+		const qreal a = yl[i];
+		const qreal d = yr[i] - a;
+		const qreal y0 = a + d * t0;
+		const qreal y1 = a + d * t1;
+		if(qIsNaN(y0) || qIsNaN(y1) ||
+		   qMax(y0, y1) < top || qMin(y0, y1) > bottom)
+			continue;
+
+		const qreal dy = y1 - y0;
+		qreal s = 0, e = 1;
+		if(y0 < top) s = (top - y0) / dy;
+		else if(y0 > bottom) s = (bottom - y0) / dy;
+		if(y1 < top) e = (top - y0) / dy;
+		else if(y1 > bottom) e = (bottom - y0) / dy;
+		if(rows)
+			rows[cnt] = i;
+		out[cnt++] = QLineF(x0 + (x1 - x0) * s, y0 + dy * s,
+			x0 + (x1 - x0) * e, y0 + dy * e);
+	}
+	return cnt;
+}
+
+}
+
+int ParallelCoordsClipper::clipPair(qreal xl, qreal xr,
+	qreal const *yl, qreal const *yr, int n,
+	QRectF const& rect, QLineF *out, int *rows,
+	quint64 const *validLeft, quint64 const *validRight)
+{
+	if(n <= 0 || xr < rect.left() || xl > rect.right() || !(xr > xl))
+		return 0;
+
+	// The horizontal cut is the same for every segment of the pair,
+	// it is a fixed blend of the two ends
+	pairCut c;
+	c.t0 = qMax(0.0, (rect.left() - xl) / (xr - xl));
+	c.t1 = qMin(1.0, (rect.right() - xl) / (xr - xl));
+	c.x0 = xl + (xr - xl) * c.t0;
+	c.x1 = xl + (xr - xl) * c.t1;
+	c.top = rect.top();
+	c.bottom = rect.bottom();
+	c.yl = yl;
+	c.yr = yr;
+	c.out = out;
+	c.rows = rows;
+
+	if(!validLeft || !validRight)
+		return clipRows(c, 0, n, 0);
+
+	// The rows drawn are those valid at both ends, 64 at a time. Words
+	// with no row are skipped, runs of rows are clipped together.
+	int cnt = 0;
+	for(int w=0; w*64<n; w++) {
+		quint64 bits = validLeft[w] & validRight[w];
+		while(bits) {
+			const int first = lowestBit(bits);
+			const quint64 run = ~(bits >> first);
+			const int end = first + (run ? lowestBit(run) : 64);
+			cnt = clipRows(c, w * 64 + first, qMin(n, w * 64 + end), cnt);
+			bits = end < 64 ? bits & (~static_cast<quint64>(0) << end) : 0;
+		}
+	}
+	return cnt;
+}
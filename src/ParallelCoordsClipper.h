@@ -0,0 +1,24 @@
+#ifndef __PARALLELCOORDSCLIPPER_H__
+#define __PARALLELCOORDSCLIPPER_H__
+
+#include "ParallelCoordinates.h"
+
+// Clips the segments between one pair of axes against a rectangle.
+// Segment i runs from (xl, yl[i]) to (xr, yr[i]); what is left of it
+// inside rect is written to out, segments with a NaN end or entirely
+// outside are dropped. out needs room for n lines. With validLeft and
+// validRight only the rows whose bit is set in both are clipped, whole
+// words of 64 rows without one are skipped.
+class ParallelCoordsClipper
+{
+public:
+	// Returns the number of lines written. Unless rows is nullptr it
+	// receives the segment index of every line written.
+	static int clipPair(qreal xl, qreal xr,
+		qreal const *yl, qreal const *yr, int n,
+		QRectF const& rect, QLineF *out, int *rows = nullptr,
+		quint64 const *validLeft = nullptr,
+		quint64 const *validRight = nullptr);
+};
+
+#endif
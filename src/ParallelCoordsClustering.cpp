@@ -0,0 +1,375 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsClustering.h"
+#include <functional>
+#include <limits>
+#include <random>
+
+namespace {
+
+// The normalization the centroids live in, value * scale + offset
+// maps the range of an axis onto [0, 1]
+struct axisScales {
+	QVector<qreal> scale;
+	QVector<qreal> offset;
+};
+
+struct rowRange {
+	int begin;
+	int end;
+};
+
+// What one range of a batch adds to the clusters, cluster major.
+// Collapsed duplicates count as often as they were read.
+struct batchSums {
+	QVector<double> sum;		// of the normalized values
+	QVector<double> count;		// values present
+	QVector<double> members;	// per cluster
+	QVector<double> histogram;	// bins per cluster and axis
+};
+
+}
+
+static axisScales normalization(QVector<qreal> const& axisMin,
+	QVector<qreal> const& axisMax)
+{
+	// constant axes all sit in the middle
+	axisScales s;
+	for(int a=0; a<axisMin.count(); a++) {
+		const qreal span = axisMax[a] - axisMin[a];
+		s.scale.push_back(span > 0 ? 1.0 / span : 0.0);
+		s.offset.push_back(span > 0 ? -axisMin[a] / span : 0.5);
+	}
+	return s;
+}
+
+// The rows of a range normalized, axis major, missing values are NaN
+static void readRange(ParallelCoordsDataSnapshot const *data, rowRange range,
+	axisScales const *scales, QVector<qreal> &x)
+{
+	const int axisCnt = data->axis_count();
+	const int n = range.end - range.begin;
+	QVector<qreal> buffer;
+	x.resize(axisCnt * n);
+	for(int a=0; a<axisCnt; a++) {
+		qreal const *col = data->columnChunk(a, range.begin, n, buffer);
+		qreal *out = x.data() + a * n;
+		const qreal scale = scales->scale[a];
+		const qreal offset = scales->offset[a];
+		for(int i=0; i<n; i++)
+			out[i] = col[i] * scale + offset;
+	}
+}
+
+// Mean squared distance over the axes both the row and a centroid
+// have, -1 for a row that shares no axis with any centroid
+static int nearestCluster(qreal const *x, int n, int row,
+	qreal const *centroids, int clusterCnt, int axisCnt)
+{
+	int best = -1;
+	qreal bestDist = std::numeric_limits<qreal>::max();
+	for(int c=0; c<clusterCnt; c++) {
+		qreal const *centroid = centroids + c * axisCnt;
+		qreal d = 0;
+		int shared = 0;
+		for(int a=0; a<axisCnt; a++) {
+			const qreal diff = x[a * n + row] - centroid[a];
+			if(qIsNaN(diff))
+				continue;
+			d += diff * diff;
+			shared++;
+		}
+		if(shared > 0 && d / shared < bestDist) {
+			bestDist = d / shared;
+			best = c;
+		}
+	}
+	return best;
+}
+
+static batchSums assignRange(rowRange range,
+	ParallelCoordsDataSnapshot const *data, axisScales const *scales,
+	QVector<qreal> const *centroids, int clusterCnt, int bins)
+{
+	const int axisCnt = data->axis_count();
+	const int n = range.end - range.begin;
+	batchSums s;
+	s.sum.fill(0.0, clusterCnt * axisCnt);
+	s.count.fill(0.0, clusterCnt * axisCnt);
+	s.members.fill(0.0, clusterCnt);
+	s.histogram.fill(0.0, clusterCnt * axisCnt * bins);
+
+	QVector<qreal> x;
+	readRange(data, range, scales, x);
+	QVector<quint32> weightBuffer;
+	quint32 const *weights = data->weightChunk(range.begin, n, weightBuffer);
+
+	for(int i=0; i<n; i++) {
+		const int c = nearestCluster(x.constData(), n, i,
+			centroids->constData(), clusterCnt, axisCnt);
+		if(c < 0)
+			continue;
+		const double w = weights ? weights[i] : 1;
+		s.members[c] += w;
+		for(int a=0; a<axisCnt; a++) {
+			const qreal v = x[a * n + i];
+			if(qIsNaN(v))
+				continue;
+			s.sum[c * axisCnt + a] += w * v;
+			s.count[c * axisCnt + a] += w;
+			const int bin = qBound(0, static_cast<int>(v * bins), bins - 1);
+			s.histogram[(c * axisCnt + a) * bins + bin] += w;
+		}
+	}
+	return s;
+}
+
+static void reduceBatch(batchSums &result, batchSums const& partial)
+{
+	if(result.members.isEmpty()) {
+		result = partial;
+		return;
+	}
+	for(int i=0; i<result.sum.count(); i++) {
+		result.sum[i] += partial.sum[i];
+		result.count[i] += partial.count[i];
+	}
+	for(int i=0; i<result.members.count(); i++)
+		result.members[i] += partial.members[i];
+	for(int i=0; i<result.histogram.count(); i++)
+		result.histogram[i] += partial.histogram[i];
+}
+
+// Marks the members of one cluster in a range starting at a multiple
+// of 64, ranges own their words of the mask
+static void markMembers(rowRange range,
+	ParallelCoordsDataSnapshot const *data, axisScales const *scales,
+	QVector<qreal> const *centroids, int clusterCnt, int cluster,
+	quint64 *words)
+{
+	const int n = range.end - range.begin;
+	QVector<qreal> x;
+	readRange(data, range, scales, x);
+	for(int i=0; i<n; i++) {
+		if(nearestCluster(x.constData(), n, i, centroids->constData(),
+				clusterCnt, data->axis_count()) != cluster)
+			continue;
+		const int row = range.begin + i;
+		words[row >> 6] |= static_cast<quint64>(1) << (row & 63);
+	}
+}
+
+static qreal quantile(double const *histogram, int bins, qreal q)
+{
+	double total = 0;
+	for(int b=0; b<bins; b++)
+		total += histogram[b];
+	if(total <= 0)
+		return std::numeric_limits<qreal>::quiet_NaN();
+
+	double seen = 0;
+	for(int b=0; b<bins; b++) {
+		seen += histogram[b];
+		if(seen >= q * total)
+			return (b + 0.5) / bins;
+	}
+	return 1;
+}
+
+ParallelCoordsClustering::ParallelCoordsClustering(QObject *parent,
+	QParallelCoordsData const *data_, int clusterCnt_, quint32 seed_)
+: QObject(parent), data(data_->snapshot()), clusterCnt(clusterCnt_),
+  seed(seed_), cancelled(false)
+{
+	blockRows = 4096;
+	// fixed rather than per core, the rounds and with them the
+	// clusters are the same on every machine
+	batchBlocks = 32;
+	histogramBins = 64;
+	histogramDecay = 0.95;
+	lowQuantile = 0.1;
+	highQuantile = 0.9;
+	refineMsecs = 200;
+
+	qRegisterMetaType<ParallelCoordsClusterSummary>(
+		"ParallelCoordsClusterSummary");
+}
+
+ParallelCoordsClustering::~ParallelCoordsClustering()
+{
+	cancel();
+	future.waitForFinished();
+}
+
+void ParallelCoordsClustering::start()
+{
+	if(future.isRunning())
+		return;
+	cancelled = false;
+	future = QtConcurrent::run(this, &ParallelCoordsClustering::run);
+}
+
+void ParallelCoordsClustering::cancel()
+{
+	cancelled = true;
+}
+
+void ParallelCoordsClustering::run()
+{
+	const int rowCnt = data->length();
+	const int axisCnt = data->axis_count();
+	const int k = qMin(clusterCnt, rowCnt);
+	if(k <= 0 || axisCnt <= 0) {
+		emit finished(false);
+		return;
+	}
+
+	QVector<qreal> axisMin(axisCnt), axisMax(axisCnt);
+	for(int a=0; a<axisCnt; a++) {
+		axisMin[a] = data->getRange(a).first;
+		axisMax[a] = data->getRange(a).second;
+	}
+	const axisScales scales = normalization(axisMin, axisMax);
+
+	// Only the raw output of the generator is used, it is the same
+	// with every standard library, the distributions are not
+	std::mt19937 rng(seed);
+
+	// Rows picked at random start off the centroids
+	QVector<qreal> centroids(k * axisCnt);
+	for(int c=0; c<k; c++) {
+		const int row = rng() % rowCnt;
+		for(int a=0; a<axisCnt; a++) {
+			centroids[c * axisCnt + a] =
+				data->value(row, a) * scales.scale[a] + scales.offset[a];
+		}
+	}
+
+	// One pass over the data, block by block in a random order
+	const int blockCnt = (rowCnt + blockRows - 1) / blockRows;
+	QVector<int> blocks(blockCnt);
+	for(int i=0; i<blockCnt; i++)
+		blocks[i] = i;
+	for(int i=blockCnt-1; i>0; i--)
+		qSwap(blocks[i], blocks[rng() % (i + 1)]);
+
+	QVector<double> seen(k * axisCnt, 0.0);		// values each centroid met
+	QVector<double> members(k, 0.0);
+	QVector<double> histogram(k * axisCnt * histogramBins, 0.0);
+	qint64 rowsSeen = 0;
+	QElapsedTimer refineTimer;
+	refineTimer.start();
+
+	using namespace std::placeholders;
+	for(int next=0; next<blockCnt && !cancelled; ) {
+		QList<rowRange> batch;
+		for(int i=0; i<batchBlocks && next<blockCnt; i++, next++) {
+			const int first = blocks[next] * blockRows;
+			rowRange r = {first, qMin(first + blockRows, rowCnt)};
+			batch.push_back(r);
+			rowsSeen += r.end - r.begin;
+		}
+
+		// Reduced in order so the sums, and so the clusters, do not
+		// depend on which thread finished first
+		batchSums sums = QtConcurrent::blockingMappedReduced<batchSums>(
+			batch, std::bind(assignRange, _1, data.data(), &scales,
+				&centroids, k, histogramBins),
+			reduceBatch, QtConcurrent::OrderedReduce);
+
+		// Each centroid moves to the mean of what it was given with a
+		// rate of its share of all the values it met so far
+		for(int i=0; i<k * axisCnt; i++) {
+			if(sums.count[i] <= 0)
+				continue;
+			seen[i] += sums.count[i];
+			const qreal mean = sums.sum[i] / sums.count[i];
+			if(qIsNaN(centroids[i]))
+				centroids[i] = mean;
+			else
+				centroids[i] += (mean - centroids[i]) * sums.count[i] / seen[i];
+		}
+		for(int c=0; c<k; c++)
+			members[c] += sums.members[c];
+		for(int i=0; i<histogram.count(); i++)
+			histogram[i] = histogram[i] * histogramDecay + sums.histogram[i];
+
+		const bool last = next >= blockCnt;
+		if(!last && refineTimer.elapsed() < refineMsecs)
+			continue;
+		refineTimer.restart();
+
+		ParallelCoordsClusterSummary s;
+		s.axisCnt = axisCnt;
+		s.clusterCnt = k;
+		s.rowsSeen = rowsSeen;
+		s.final = last;
+		s.axisMin = axisMin;
+		s.axisMax = axisMax;
+		double memberTotal = 0;
+		for(int c=0; c<k; c++)
+			memberTotal += members[c];
+		for(int c=0; c<k; c++) {
+			s.share.push_back(memberTotal > 0 ? members[c] / memberTotal : 0);
+			for(int a=0; a<axisCnt; a++) {
+				const int i = c * axisCnt + a;
+				const qreal span = axisMax[a] - axisMin[a];
+				double const *h = histogram.constData() + i * histogramBins;
+				s.centroids.push_back(axisMin[a] + centroids[i] * span);
+				s.low.push_back(axisMin[a] +
+					quantile(h, histogramBins, lowQuantile) * span);
+				s.high.push_back(axisMin[a] +
+					quantile(h, histogramBins, highQuantile) * span);
+			}
+		}
+		emit refined(s);
+	}
+
+	emit finished(!cancelled);
+}
+
+ParallelCoordsRowMask ParallelCoordsClustering::members(
+	ParallelCoordsDataSnapshot::pointer snapshot,
+	ParallelCoordsClusterSummary summary, int cluster)
+{
+	const int rowCnt = snapshot->length();
+	const int axisCnt = summary.axisCnt;
+	rowMask *mask = new rowMask;
+	mask->words.fill(0, (rowCnt + 63) / 64);
+	if(axisCnt != snapshot->axis_count() || cluster < 0 ||
+	   cluster >= summary.clusterCnt)
+		return ParallelCoordsRowMask(mask);
+
+	// Back into the normalization the clusters were fitted in, rows
+	// appended since may fall outside of it
+	const axisScales scales = normalization(summary.axisMin, summary.axisMax);
+	QVector<qreal> centroids(summary.centroids.count());
+	for(int i=0; i<centroids.count(); i++) {
+		const int a = i % axisCnt;
+		centroids[i] = summary.centroids[i] * scales.scale[a] +
+			scales.offset[a];
+	}
+
+	// Ranges are segments of the data, read in place where possible
+	QList<rowRange> ranges;
+	const int rangeLength = ParallelCoordsDataSnapshot::segmentRows;
+	for(int i=0; i<rowCnt; i+=rangeLength) {
+		rowRange r = {i, qMin(i + rangeLength, rowCnt)};
+		ranges.push_back(r);
+	}
+	using namespace std::placeholders;
+	QtConcurrent::blockingMap(ranges, std::bind(markMembers, _1,
+		snapshot.data(), &scales, &centroids, summary.clusterCnt, cluster,
+		mask->words.data()));
+
+	QCryptographicHash h(QCryptographicHash::Sha1);
+	h.addData(snapshot->contentHash());
+	{
+		QByteArray b;
+		QDataStream strm(&b, QIODevice::WriteOnly);
+		strm << summary.centroids << summary.axisMin << summary.axisMax
+			 << cluster;
+		h.addData(b);
+	}
+	mask->hash = h.result();
+	return ParallelCoordsRowMask(mask);
+}
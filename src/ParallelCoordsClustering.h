@@ -0,0 +1,73 @@
+#ifndef __PARALLELCOORDSCLUSTERING_H__
+#define __PARALLELCOORDSCLUSTERING_H__
+
+#include "ParallelCoordinates.h"
+#include "QParallelCoordsData.h"
+#include <atomic>
+
+// What the clusters look like so far, in data units. Values are
+// cluster major, the value of cluster c on axis a is at
+// c * axisCnt + a, NaN where no member of the cluster had one.
+struct ParallelCoordsClusterSummary {
+	int axisCnt;
+	int clusterCnt;
+	qint64 rowsSeen;			// rows the centroids were fitted to so far
+	bool final;
+	QVector<qreal> centroids;
+	QVector<qreal> low;			// lower and upper quantile of the members
+	QVector<qreal> high;
+	QVector<qreal> share;		// estimated fraction of the rows per cluster
+	QVector<qreal> axisMin;		// ranges the columns were normalized to
+	QVector<qreal> axisMax;
+
+	ParallelCoordsClusterSummary()
+	: axisCnt(0), clusterCnt(0), rowsSeen(0), final(false) {}
+};
+
+// Summarizes the rows as a few clusters by mini-batch k-means over
+// the columns normalized to their range. Every round assigns a batch
+// of randomly picked blocks of rows to their nearest centroid on all
+// cores and moves each centroid towards the mean of its share with a
+// rate that falls as the centroid sees more rows. A summary is handed
+// out as the clusters get refined, the same seed gives the same
+// clusters on the same data.
+class ParallelCoordsClustering : public QObject
+{
+	Q_OBJECT
+
+public:
+	ParallelCoordsClustering(QObject *parent,
+		QParallelCoordsData const *data, int clusterCnt, quint32 seed);
+	~ParallelCoordsClustering();
+
+	void start();
+	void cancel();
+
+	// The rows of snapshot whose nearest centroid is cluster, found
+	// on all cores
+	static ParallelCoordsRowMask members(
+		ParallelCoordsDataSnapshot::pointer snapshot,
+		ParallelCoordsClusterSummary summary, int cluster);
+
+signals:
+	void refined(ParallelCoordsClusterSummary summary);
+	void finished(bool ok);
+
+private:
+	ParallelCoordsDataSnapshot::pointer data;
+	int clusterCnt;
+	quint32 seed;
+	int blockRows;			// rows read together, a multiple of 64
+	int batchBlocks;		// blocks per round
+	int histogramBins;		// per cluster and axis, for the quantiles
+	qreal histogramDecay;	// per round, so early assignments fade out
+	qreal lowQuantile;
+	qreal highQuantile;
+	int refineMsecs;		// summaries are handed out at most this often
+	QFuture<void> future;
+	std::atomic<bool> cancelled;
+
+	void run();
+};
+
+#endif
@@ -0,0 +1,513 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsColumnCodec.h"
+#include <cstring>
+
+// Same dispatch as the projection, vector kernels are only called when
+// the cpu reports their instruction set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PC_CODEC_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Codes are unpacked this many at a time into a buffer on the stack
+const int unpackRows = 512;
+// Blocks with more distinct values than this get no dictionary
+const int maxDictionary = 4096;
+// Decimal places tried before a block is taken as not fixed point
+const int maxDecimals = 6;
+
+typedef void (*widenKernel)(void const *in, quint32 *out, int n);
+typedef void (*affineKernel)(quint32 const *codes, qreal *out, int n,
+	qreal a, qreal b);
+
+void widen8Scalar(void const *in, quint32 *out, int n)
+{
+	quint8 const *src = static_cast<quint8 const*>(in);
+	for(int i=0; i<n; i++)
+		out[i] = src[i];
+}
+
+void widen16Scalar(void const *in, quint32 *out, int n)
+{
+	quint16 const *src = static_cast<quint16 const*>(in);
+	for(int i=0; i<n; i++)
+		out[i] = src[i];
+}
+
+// out = code * a + b, codes stay below 2^31
+void affineScalar(quint32 const *codes, qreal *out, int n, qreal a, qreal b)
+{
+	for(int i=0; i<n; i++)
+		out[i] = static_cast<qint32>(codes[i]) * a + b;
+}
+
+}
+
+#ifdef PC_CODEC_DISPATCH
+
+__attribute__((target("sse2")))
+static void widen8Sse2(void const *in, quint32 *out, int n)
+{
+	quint8 const *src = static_cast<quint8 const*>(in);
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for(; i+16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i));
+		__m128i lo = _mm_unpacklo_epi8(x, zero);
+		__m128i hi = _mm_unpackhi_epi8(x, zero);
+		__m128i *dst = reinterpret_cast<__m128i*>(out+i);
+		_mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(dst+1, _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(dst+2, _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(dst+3, _mm_unpackhi_epi16(hi, zero));
+	}
+	for(; i<n; i++)
+		out[i] = src[i];
+}
+
+__attribute__((target("sse2")))
+static void widen16Sse2(void const *in, quint32 *out, int n)
+{
+	quint16 const *src = static_cast<quint16 const*>(in);
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+	for(; i+8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i));
+		__m128i *dst = reinterpret_cast<__m128i*>(out+i);
+		_mm_storeu_si128(dst, _mm_unpacklo_epi16(x, zero));
+		_mm_storeu_si128(dst+1, _mm_unpackhi_epi16(x, zero));
+	}
+	for(; i<n; i++)
+		out[i] = src[i];
+}
+
+__attribute__((target("sse2")))
+static void affineSse2(quint32 const *codes, qreal *out, int n,
+	qreal a, qreal b)
+{
+	double *dst = reinterpret_cast<double*>(out);
+	const __m128d va = _mm_set1_pd(a);
+	const __m128d vb = _mm_set1_pd(b);
+	int i = 0;
+	for(; i+4 <= n; i += 4) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(codes+i));
+		__m128d x0 = _mm_cvtepi32_pd(c);
+		__m128d x1 = _mm_cvtepi32_pd(_mm_srli_si128(c, 8));
+		_mm_storeu_pd(dst+i, _mm_add_pd(_mm_mul_pd(x0, va), vb));
+		_mm_storeu_pd(dst+i+2, _mm_add_pd(_mm_mul_pd(x1, va), vb));
+	}
+	for(; i<n; i++)
+		dst[i] = static_cast<qint32>(codes[i]) * a + b;
+}
+
+__attribute__((target("avx2")))
+static void widen8Avx2(void const *in, quint32 *out, int n)
+{
+	quint8 const *src = static_cast<quint8 const*>(in);
+	int i = 0;
+	for(; i+8 <= n; i += 8) {
+		__m128i x = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src+i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),
+			_mm256_cvtepu8_epi32(x));
+	}
+	for(; i<n; i++)
+		out[i] = src[i];
+}
+
+__attribute__((target("avx2")))
+static void widen16Avx2(void const *in, quint32 *out, int n)
+{
+	quint16 const *src = static_cast<quint16 const*>(in);
+	int i = 0;
+	for(; i+8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src+i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),
+			_mm256_cvtepu16_epi32(x));
+	}
+	for(; i<n; i++)
+		out[i] = src[i];
+}
+
+__attribute__((target("avx2")))
+static void affineAvx2(quint32 const *codes, qreal *out, int n,
+	qreal a, qreal b)
+{
+	double *dst = reinterpret_cast<double*>(out);
+	const __m256d va = _mm256_set1_pd(a);
+	const __m256d vb = _mm256_set1_pd(b);
+	int i = 0;
+	for(; i+8 <= n; i += 8) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(codes+i));
+		__m256d x0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(c));
+		__m256d x1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(c, 1));
+		_mm256_storeu_pd(dst+i, _mm256_add_pd(_mm256_mul_pd(x0, va), vb));
+		_mm256_storeu_pd(dst+i+4, _mm256_add_pd(_mm256_mul_pd(x1, va), vb));
+	}
+	for(; i<n; i++)
+		dst[i] = static_cast<qint32>(codes[i]) * a + b;
+}
+
+#endif
+
+namespace {
+
+struct kernelChoice {
+	widenKernel widen8;
+	widenKernel widen16;
+	affineKernel affine;
+	char const *name;
+};
+
+kernelChoice chooseKernel()
+{
+	kernelChoice choice = {widen8Scalar, widen16Scalar, affineScalar, "scalar"};
+#ifdef PC_CODEC_DISPATCH
+	if(sizeof(qreal) != sizeof(double))
+		return choice;
+
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		kernelChoice avx2 = {widen8Avx2, widen16Avx2, affineAvx2, "avx2"};
+		choice = avx2;
+	}
+	else if(__builtin_cpu_supports("sse2")) {
+		kernelChoice sse2 = {widen8Sse2, widen16Sse2, affineSse2, "sse2"};
+		choice = sse2;
+	}
+#endif
+	return choice;
+}
+
+kernelChoice const& kernel()
+{
+	static const kernelChoice choice = chooseKernel();
+	return choice;
+}
+
+inline bool isPresent(quint64 const *validity, int i)
+{
+	return (validity[i >> 6] >> (i & 63)) & 1;
+}
+
+inline bool sameBits(qreal a, qreal b)
+{
+	return memcmp(&a, &b, sizeof(qreal)) == 0;
+}
+
+inline quint64 zigzag(qint64 d)
+{
+	return (static_cast<quint64>(d) << 1) ^ static_cast<quint64>(d >> 63);
+}
+
+inline qint64 unzigzag(quint64 c)
+{
+	return static_cast<qint64>(c >> 1) ^ -static_cast<qint64>(c & 1);
+}
+
+// Smallest code width holding max, widths never straddle a word
+int bitsFor(quint64 max)
+{
+	int bits = 0;
+	while(bits < 64 && (max >> bits) != 0)
+		bits++;
+	static const int widths[] = {0, 1, 2, 4, 8, 16, 32, 64};
+	for(int i=0; ; i++) {
+		if(widths[i] >= bits)
+			return widths[i];
+	}
+}
+
+// Every present value as an integer count of 1/divisor, false unless
+// all of them come back bit for bit. Missing rows repeat the value
+// before them so they cost nothing in either encoding.
+bool toFixed(qreal const *values, quint64 const *validity, int n,
+	qreal divisor, qint64 *out)
+{
+	const qreal limit = 9007199254740992.0;		// 2^53
+	bool seen = false;
+	qint64 last = 0;
+	for(int i=0; i<n; i++) {
+		if(!isPresent(validity, i)) {
+			out[i] = last;
+			continue;
+		}
+		const qreal scaled = values[i] * divisor;
+		if(!(qAbs(scaled) < limit))
+			return false;
+		const qint64 m = qRound64(scaled);
+		if(!sameBits(static_cast<qreal>(m) / divisor, values[i]))
+			return false;
+		if(!seen) {
+			for(int j=0; j<i; j++)
+				out[j] = m;
+			seen = true;
+		}
+		out[i] = last = m;
+	}
+	return true;
+}
+
+QVector<quint64> pack(QVector<quint32> const& codes, int bits)
+{
+	QVector<quint64> words(static_cast<int>(
+		(static_cast<qint64>(codes.count()) * bits + 63) / 64), 0);
+	if(bits == 0)
+		return words;
+	for(int i=0; i<codes.count(); i++) {
+		const qint64 bit = static_cast<qint64>(i) * bits;
+		words[bit >> 6] |= static_cast<quint64>(codes[i]) << (bit & 63);
+	}
+	return words;
+}
+
+// Byte aligned widths are read as plain arrays, which is how shifts
+// into words lay them out on a little endian cpu
+void unpack(ParallelCoordsColumnCodec::block const& b, int first, int n,
+	quint32 *out)
+{
+	void const *words = b.words.constData();
+	switch(b.bits) {
+	case 0:
+		memset(out, 0, n * sizeof(quint32));
+		return;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+	case 8:
+		kernel().widen8(static_cast<quint8 const*>(words) + first, out, n);
+		return;
+	case 16:
+		kernel().widen16(static_cast<quint16 const*>(words) + first, out, n);
+		return;
+	case 32:
+		memcpy(out, static_cast<quint32 const*>(words) + first,
+			n * sizeof(quint32));
+		return;
+#endif
+	default:
+		break;
+	}
+
+	quint64 const *w = b.words.constData();
+	const quint64 mask = (Q_UINT64_C(1) << b.bits) - 1;
+	for(int i=0; i<n; i++) {
+		const qint64 bit = static_cast<qint64>(first + i) * b.bits;
+		out[i] = static_cast<quint32>((w[bit >> 6] >> (bit & 63)) & mask);
+	}
+}
+
+// Writes value * a + c, or the value itself when exact is set
+void expand(ParallelCoordsColumnCodec::block const& b, int first, int count,
+	qreal a, qreal c, bool exact, qreal *out)
+{
+	quint32 codes[unpackRows];
+
+	switch(b.encoding) {
+	case ParallelCoordsColumnCodec::FrameOfReference: {
+		// base + code is an exact integer, dividing afterwards gives
+		// back the value. Projected, the whole mapping folds into a
+		// single multiply add per code.
+		const qreal fa = exact ? 1 : a / b.divisor;
+		const qreal fc = exact ? static_cast<qreal>(b.base) :
+			(b.base / b.divisor) * a + c;
+		for(int done=0; done<count; done+=unpackRows) {
+			const int n = qMin(unpackRows, count - done);
+			unpack(b, first + done, n, codes);
+			kernel().affine(codes, out + done, n, fa, fc);
+			if(exact && b.divisor != 1) {
+				for(int i=0; i<n; i++)
+					out[done+i] /= b.divisor;
+			}
+		}
+		break;
+	}
+
+	case ParallelCoordsColumnCodec::Dictionary: {
+		// projected, the dictionary is mapped once per call
+		QVector<qreal> table = b.dictionary;
+		if(!exact) {
+			for(int i=0; i<table.count(); i++)
+				table[i] = table[i] * a + c;
+		}
+		qreal const *t = table.constData();
+		for(int done=0; done<count; done+=unpackRows) {
+			const int n = qMin(unpackRows, count - done);
+			unpack(b, first + done, n, codes);
+			for(int i=0; i<n; i++)
+				out[done+i] = t[codes[i]];
+		}
+		break;
+	}
+
+	case ParallelCoordsColumnCodec::Delta: {
+		// The sum runs from the last checkpoint before first
+		const int cp = ParallelCoordsColumnCodec::checkpointRows;
+		const int end = first + count;
+		const qreal da = a / b.divisor;
+		qint64 sum = 0;
+		for(int row=first - first % cp; row<end; ) {
+			const int n = qMin(unpackRows, end - row);
+			unpack(b, row, n, codes);
+			for(int i=0; i<n; i++, row++) {
+				if(row % cp == 0)
+					sum = b.checkpoints[row / cp];
+				else
+					sum += unzigzag(codes[i]);
+				if(row >= first)
+					out[row-first] = exact ? sum / b.divisor : sum * da + c;
+			}
+		}
+		break;
+	}
+
+	case ParallelCoordsColumnCodec::Plain:
+		Q_ASSERT(false);
+		break;
+	}
+}
+
+}
+
+ParallelCoordsColumnCodec::block ParallelCoordsColumnCodec::encode(
+	qreal const *values, quint64 const *validity, int n)
+{
+	block b;
+	b.n = n;
+	const qint64 plainBytes = static_cast<qint64>(n) * sizeof(qreal);
+
+	// Sizes are worked out first, only the smallest encoding is built
+	Encoding best = Plain;
+	qint64 bestBytes = plainBytes * 3 / 4;
+	int bestBits = 64;
+
+	// Fixed point with the fewest decimals every value survives
+	QVector<qint64> fixed(n);
+	qreal divisor = 1;
+	bool isFixed = false;
+	for(int d=0; d<=maxDecimals; d++, divisor*=10) {
+		if(toFixed(values, validity, n, divisor, fixed.data())) {
+			isFixed = true;
+			break;
+		}
+	}
+
+	qint64 lo = 0;
+	if(isFixed && n > 0) {
+		lo = fixed[0];
+		qint64 hi = fixed[0];
+		quint64 maxStep = 0;
+		for(int i=1; i<n; i++) {
+			lo = qMin(lo, fixed[i]);
+			hi = qMax(hi, fixed[i]);
+			if(i % checkpointRows != 0)
+				maxStep = qMax(maxStep, zigzag(fixed[i] - fixed[i-1]));
+		}
+
+		// codes go through signed conversions, so they stay below 2^31
+		const quint64 range = static_cast<quint64>(hi - lo);
+		const int forBits = bitsFor(range);
+		const qint64 forBytes = static_cast<qint64>(n) * forBits / 8;
+		if(range < (Q_UINT64_C(1) << 31) && forBytes < bestBytes) {
+			best = FrameOfReference;
+			bestBytes = forBytes;
+			bestBits = forBits;
+		}
+
+		const int deltaBits = bitsFor(maxStep);
+		const qint64 deltaBytes = static_cast<qint64>(n) * deltaBits / 8 +
+			(n / checkpointRows + 1) * sizeof(qint64);
+		if(deltaBits <= 32 && deltaBytes < bestBytes) {
+			best = Delta;
+			bestBytes = deltaBytes;
+			bestBits = deltaBits;
+		}
+	}
+
+	// Values are told apart by their bits, so -0 and 0 stay apart
+	QHash<quint64, int> dictionary;
+	QVector<qreal> distinct;
+	for(int i=0; i<n && distinct.count() <= maxDictionary; i++) {
+		if(!isPresent(validity, i))
+			continue;
+		quint64 key;
+		memcpy(&key, &values[i], sizeof(key));
+		if(!dictionary.contains(key)) {
+			dictionary.insert(key, distinct.count());
+			distinct.push_back(values[i]);
+		}
+	}
+	if(distinct.count() <= maxDictionary) {
+		const int dictBits = bitsFor(qMax(distinct.count() - 1, 0));
+		const qint64 dictBytes = static_cast<qint64>(n) * dictBits / 8 +
+			distinct.count() * sizeof(qreal);
+		if(dictBytes < bestBytes) {
+			best = Dictionary;
+			bestBytes = dictBytes;
+			bestBits = dictBits;
+		}
+	}
+
+	if(best == Plain)
+		return b;
+
+	QVector<quint32> codes(n, 0);
+	b.encoding = best;
+	b.bits = bestBits;
+	switch(best) {
+	case FrameOfReference:
+		b.base = lo;
+		b.divisor = divisor;
+		for(int i=0; i<n; i++)
+			codes[i] = static_cast<quint32>(fixed[i] - lo);
+		break;
+	case Delta:
+		b.divisor = divisor;
+		for(int i=0; i<n; i++) {
+			if(i % checkpointRows == 0)
+				b.checkpoints.push_back(fixed[i]);
+			else
+				codes[i] = static_cast<quint32>(zigzag(fixed[i] - fixed[i-1]));
+		}
+		break;
+	case Dictionary:
+		b.dictionary = distinct;
+		for(int i=0; i<n; i++) {
+			if(!isPresent(validity, i))
+				continue;
+			quint64 key;
+			memcpy(&key, &values[i], sizeof(key));
+			codes[i] = dictionary.value(key);
+		}
+		break;
+	case Plain:
+		break;
+	}
+	b.words = pack(codes, b.bits);
+	return b;
+}
+
+void ParallelCoordsColumnCodec::decode(block const& b, int first, int count,
+	qreal *out)
+{
+	expand(b, first, count, 1, 0, true, out);
+}
+
+void ParallelCoordsColumnCodec::project(block const& b, int first, int count,
+	qreal min, qreal scale, qreal offset, qreal *out)
+{
+	expand(b, first, count, scale, offset - min * scale, false, out);
+}
+
+qint64 ParallelCoordsColumnCodec::byteSize(block const& b)
+{
+	if(b.encoding == Plain)
+		return static_cast<qint64>(b.n) * sizeof(qreal);
+	return static_cast<qint64>(b.words.count()) * sizeof(quint64) +
+		b.dictionary.count() * sizeof(qreal) +
+		b.checkpoints.count() * sizeof(qint64);
+}
+
+char const* ParallelCoordsColumnCodec::kernelName()
+{
+	return kernel().name;
+}
@@ -0,0 +1,50 @@
+#ifndef __PARALLELCOORDSCOLUMNCODEC_H__
+#define __PARALLELCOORDSCOLUMNCODEC_H__
+
+#include "ParallelCoordinates.h"
+
+// Lossless compression of one block of a numeric column. Values are
+// turned into small codes, bit packed, that map back through a
+// dictionary, a frame of reference or a running sum of deltas,
+// whichever is smallest for the block. Decoding unpacks a few hundred
+// codes at a time with the widest vector unit the cpu has and can
+// project them onto an axis on the way, the values of the block are
+// never written out as a whole.
+class ParallelCoordsColumnCodec
+{
+public:
+	enum Encoding { Plain, Dictionary, FrameOfReference, Delta };
+
+	// Delta blocks restart their running sum every this many rows
+	static const int checkpointRows = 1024;
+
+	struct block {
+		Encoding encoding;
+		int n;
+		int bits;						// per code, 0, 1, 2, 4, 8, 16 or 32
+		// Fixed point values, value = (base + code) / divisor for a
+		// frame of reference and running sum / divisor for deltas
+		qint64 base;
+		qreal divisor;
+		QVector<qreal> dictionary;
+		QVector<qint64> checkpoints;	// running sum at each checkpoint
+		QVector<quint64> words;			// packed codes
+
+		block() : encoding(Plain), n(0), bits(0), base(0), divisor(1) {}
+	};
+
+	// Plain when no encoding saves enough to be worth it, the values
+	// are then kept as they are. Rows without their validity bit may
+	// decode to anything.
+	static block encode(qreal const *values, quint64 const *validity, int n);
+	static void decode(block const& b, int first, int count, qreal *out);
+	// out[i] = (value - min) * scale + offset, as in
+	// ParallelCoordsProjection but without the values in between
+	static void project(block const& b, int first, int count,
+		qreal min, qreal scale, qreal offset, qreal *out);
+	static qint64 byteSize(block const& b);
+	// sse2, avx2 or scalar
+	static char const* kernelName();
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsDataSnapshot.h"
+#include "QParallelCoordsData.h"
+#include "ParallelCoordsProjection.h"
+#include <limits>
+
+// Rows of a decoded block without their validity bit back to NaN,
+// whole words of present rows are skipped
+static void maskMissing(quint64 const *validity, int offset, int n, qreal *out)
+{
+	const qreal missing = std::numeric_limits<qreal>::quiet_NaN();
+	for(int i=0; i<n; ) {
+		const int row = offset + i;
+		const quint64 word = validity[row >> 6];
+		if((row & 63) == 0 && n - i >= 64 && word == ~Q_UINT64_C(0)) {
+			i += 64;
+			continue;
+		}
+		if(!((word >> (row & 63)) & 1))
+			out[i] = missing;
+		i++;
+	}
+}
+
+ParallelCoordsDataSnapshot::ParallelCoordsDataSnapshot()
+: ver(0), rowCnt(0), weightedCnt(0), axisCnt(0),
+  maxValue(-std::numeric_limits<qreal>::max()), loading(false),
+  weighted(false), external(nullptr), outOfCore(false)
+{
+}
+
+quint64 ParallelCoordsDataSnapshot::version() const
+{
+	return ver;
+}
+
+int ParallelCoordsDataSnapshot::length() const
+{
+	return rowCnt;
+}
+
+qint64 ParallelCoordsDataSnapshot::weightedLength() const
+{
+	return weightedCnt;
+}
+
+int ParallelCoordsDataSnapshot::axis_count() const
+{
+	return axisCnt;
+}
+
+QPair<qreal, qreal> ParallelCoordsDataSnapshot::getRange(int axis) const
+{
+	return qMakePair(axisMin[axis], axisMax[axis]);
+}
+
+qreal ParallelCoordsDataSnapshot::getMaxValue() const
+{
+	return maxValue;
+}
+
+bool ParallelCoordsDataSnapshot::isCategorical(int axis) const
+{
+	return categorical[axis];
+}
+
+bool ParallelCoordsDataSnapshot::isLoading() const
+{
+	return loading;
+}
+
+bool ParallelCoordsDataSnapshot::isOutOfCore() const
+{
+	return outOfCore;
+}
+
+QByteArray ParallelCoordsDataSnapshot::contentHash() const
+{
+	return hash;
+}
+
+int ParallelCoordsDataSnapshot::contiguousRows() const
+{
+	return external ? std::numeric_limits<int>::max() : segmentRows;
+}
+
+ParallelCoordsRowMask ParallelCoordsDataSnapshot::selection() const
+{
+	return selected;
+}
+
+qreal ParallelCoordsDataSnapshot::value(int row, int axis) const
+{
+	if(external) {
+		QVector<qreal> buffer;
+		return *columnChunk(axis, row, 1, buffer);
+	}
+	if(!isValid(row, axis))
+		return std::numeric_limits<qreal>::quiet_NaN();
+	segment const *s = segments[axis][row >> segmentShift].data();
+	const int offset = row & (segmentRows - 1);
+	if(categorical[axis])
+		return s->codes[offset];
+	if(s->packed.encoding != ParallelCoordsColumnCodec::Plain) {
+		qreal v;
+		ParallelCoordsColumnCodec::decode(s->packed, offset, 1, &v);
+		return v;
+	}
+	return s->values[offset];
+}
+
+bool ParallelCoordsDataSnapshot::isValid(int row, int axis) const
+{
+	if(external)
+		return !qIsNaN(value(row, axis));
+	segment const *s = segments[axis][row >> segmentShift].data();
+	const int offset = row & (segmentRows - 1);
+	return (s->validity[offset >> 6] >> (offset & 63)) & 1;
+}
+
+qreal const* ParallelCoordsDataSnapshot::columnChunk(int axis, int first,
+	int count, QVector<qreal> &buffer) const
+{
+	if(external)
+		return external->externalChunk(axis, first, count, buffer);
+
+	// Numeric chunks within one uncompressed segment need no copy
+	const int offset = first & (segmentRows - 1);
+	if(!categorical[axis] && offset + count <= segmentRows && count > 0) {
+		segment const *s = segments[axis][first >> segmentShift].data();
+		if(s->packed.encoding == ParallelCoordsColumnCodec::Plain)
+			return s->values.constData() + offset;
+	}
+
+	// Otherwise gathered segment by segment, categories and compressed
+	// rows decoded and missing values set to NaN on the way
+	buffer.resize(count);
+	const qreal missing = std::numeric_limits<qreal>::quiet_NaN();
+	for(int done=0; done<count; ) {
+		const int row = first + done;
+		const int o = row & (segmentRows - 1);
+		const int n = qMin(count - done, segmentRows - o);
+		segment const *s = segments[axis][row >> segmentShift].data();
+		qreal *out = buffer.data() + done;
+		if(categorical[axis]) {
+			quint32 const *c = s->codes.constData() + o;
+			quint64 const *valid = s->validity.constData();
+			for(int i=0; i<n; i++) {
+				out[i] = ((valid[(o+i) >> 6] >> ((o+i) & 63)) & 1) ? c[i] : missing;
+			}
+		}
+		else if(s->packed.encoding != ParallelCoordsColumnCodec::Plain) {
+			ParallelCoordsColumnCodec::decode(s->packed, o, n, out);
+			maskMissing(s->validity.constData(), o, n, out);
+		}
+		else {
+			memcpy(out, s->values.constData() + o, n * sizeof(qreal));
+		}
+		done += n;
+	}
+	return buffer.constData();
+}
+
+bool ParallelCoordsDataSnapshot::canProject() const
+{
+	return external == nullptr;
+}
+
+void ParallelCoordsDataSnapshot::project(int axis, int first, int count,
+	qreal min, qreal scale, qreal offset, qreal *out) const
+{
+	Q_ASSERT(canProject());
+	const qreal missing = std::numeric_limits<qreal>::quiet_NaN();
+	for(int done=0; done<count; ) {
+		const int row = first + done;
+		const int o = row & (segmentRows - 1);
+		const int n = qMin(count - done, segmentRows - o);
+		segment const *s = segments[axis][row >> segmentShift].data();
+		qreal *y = out + done;
+		if(categorical[axis]) {
+			quint32 const *c = s->codes.constData() + o;
+			quint64 const *valid = s->validity.constData();
+			for(int i=0; i<n; i++) {
+				y[i] = ((valid[(o+i) >> 6] >> ((o+i) & 63)) & 1) ?
+					(c[i] - min) * scale + offset : missing;
+			}
+		}
+		else if(s->packed.encoding != ParallelCoordsColumnCodec::Plain) {
+			ParallelCoordsColumnCodec::project(s->packed, o, n,
+				min, scale, offset, y);
+			maskMissing(s->validity.constData(), o, n, y);
+		}
+		else {
+			ParallelCoordsProjection::project(s->values.constData() + o, y, n,
+				min, scale, offset);
+		}
+		done += n;
+	}
+}
+
+quint64 const* ParallelCoordsDataSnapshot::validityChunk(int axis, int first,
+	int count, QVector<quint64> &buffer) const
+{
+	Q_ASSERT((first & 63) == 0);
+	if(external) {
+		// column files and shared segments mark missing values with NaN
+		QVector<qreal> values;
+		qreal const *v = columnChunk(axis, first, count, values);
+		buffer.fill(0, (count + 63) / 64);
+		for(int i=0; i<count; i++) {
+			if(!qIsNaN(v[i]))
+				buffer[i >> 6] |= Q_UINT64_C(1) << (i & 63);
+		}
+		return buffer.constData();
+	}
+
+	const int offset = first & (segmentRows - 1);
+	if(offset + count <= segmentRows && count > 0)
+		return segments[axis][first >> segmentShift]->validity.constData() +
+			(offset >> 6);
+
+	// Segments hold whole words, so the words just follow each other
+	const int words = (count + 63) / 64;
+	buffer.resize(words);
+	for(int done=0; done<words; ) {
+		const int row = first + done * 64;
+		const int o = (row & (segmentRows - 1)) >> 6;
+		const int n = qMin(words - done, segmentRows / 64 - o);
+		memcpy(buffer.data() + done,
+			segments[axis][row >> segmentShift]->validity.constData() + o,
+			n * sizeof(quint64));
+		done += n;
+	}
+	return buffer.constData();
+}
+
+quint32 const* ParallelCoordsDataSnapshot::weightChunk(int first, int count,
+	QVector<quint32> &buffer) const
+{
+	if(!weighted)
+		return nullptr;
+
+	const int offset = first & (segmentRows - 1);
+	if(offset + count <= segmentRows && count > 0)
+		return weights[first >> segmentShift].constData() + offset;
+
+	buffer.resize(count);
+	for(int done=0; done<count; ) {
+		const int row = first + done;
+		const int o = row & (segmentRows - 1);
+		const int n = qMin(count - done, segmentRows - o);
+		memcpy(buffer.data() + done,
+			weights[row >> segmentShift].constData() + o, n * sizeof(quint32));
+		done += n;
+	}
+	return buffer.constData();
+}
+
+quint32 ParallelCoordsDataSnapshot::weight(int row) const
+{
+	if(!weighted)
+		return 1;
+	return weights[row >> segmentShift][row & (segmentRows - 1)];
+}
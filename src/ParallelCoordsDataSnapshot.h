@@ -0,0 +1,116 @@
+#ifndef __PARALLELCOORDSDATASNAPSHOT_H__
+#define __PARALLELCOORDSDATASNAPSHOT_H__
+
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsColumnCodec.h"
+
+class QParallelCoordsData;
+
+// A set of rows, bit i of words[i/64] set for row i, rows past its
+// end are not in it. hash names the rows for the tile keys, it is
+// derived from whatever picked them rather than from the bits.
+struct rowMask {
+	QVector<quint64> words;
+	QByteArray hash;
+
+	// Rows in the set
+	int rowCount() const
+	{
+		int rows = 0;
+		foreach(quint64 word, words) {
+#if defined(__GNUC__)
+			rows += __builtin_popcountll(word);
+#else
+			for(; word; word &= word - 1)
+				rows++;
+#endif
+		}
+		return rows;
+	}
+};
+typedef QSharedPointer<rowMask const> ParallelCoordsRowMask;
+
+// The data as it was at one version, safe to read from any thread
+// without locking. Rows are held in segments that never move once
+// allocated. A snapshot keeps the segments it knows about alive and
+// never looks past its own length, so rows can be appended behind
+// it while any number of snapshots are read.
+class ParallelCoordsDataSnapshot
+{
+public:
+	typedef QSharedPointer<ParallelCoordsDataSnapshot const> pointer;
+
+	static const int segmentShift = 16;
+	static const int segmentRows = 1 << segmentShift;
+
+	// Only the part matching the axis type is allocated. Full numeric
+	// segments may be swapped for a compressed copy, values is then
+	// empty and packed holds the rows.
+	struct segment {
+		QVector<qreal> values;
+		QVector<quint32> codes;
+		QVector<quint64> validity;		// one bit per row, set if present
+		ParallelCoordsColumnCodec::block packed;
+	};
+
+	quint64 version() const;
+	int length() const;
+	// Rows read including the duplicates collapsed into others
+	qint64 weightedLength() const;
+	int axis_count() const;
+	QPair<qreal, qreal> getRange(int axis) const;
+	qreal getMaxValue() const;
+	bool isCategorical(int axis) const;
+	bool isLoading() const;
+	bool isOutOfCore() const;
+	QByteArray contentHash() const;
+
+	// Same as in QParallelCoordsData
+	qreal value(int row, int axis) const;
+	bool isValid(int row, int axis) const;
+	qreal const* columnChunk(int axis, int first, int count,
+		QVector<qreal> &buffer) const;
+	quint64 const* validityChunk(int axis, int first, int count,
+		QVector<quint64> &buffer) const;
+	// How many input rows each row stands for, nullptr when duplicates
+	// are not collapsed and every row counts once
+	quint32 const* weightChunk(int first, int count,
+		QVector<quint32> &buffer) const;
+	quint32 weight(int row) const;
+	// out[i] = (value - min) * scale + offset for count rows, compressed
+	// segments are decoded on the way without a copy of the column.
+	// Only for data held in memory, see canProject().
+	void project(int axis, int first, int count,
+		qreal min, qreal scale, qreal offset, qreal *out) const;
+	bool canProject() const;
+	// Chunks of this many rows starting at a multiple of it are read
+	// in place unless compressed, longer ones are copied together
+	int contiguousRows() const;
+	// Rows matching the filter of the data, nullptr without a filter
+	ParallelCoordsRowMask selection() const;
+
+private:
+	friend class QParallelCoordsData;
+	ParallelCoordsDataSnapshot();
+
+	quint64 ver;
+	int rowCnt;
+	qint64 weightedCnt;
+	int axisCnt;
+	QVector<bool> categorical;
+	QVector<qreal> axisMin;
+	QVector<qreal> axisMax;
+	qreal maxValue;
+	bool loading;
+	QByteArray hash;
+	QVector<QVector<QSharedPointer<segment const>>> segments;	// per axis
+	bool weighted;
+	QVector<QVector<quint32>> weights;		// per segment
+	ParallelCoordsRowMask selected;
+	// Column files and shared memory are read through the data, their
+	// rows never change once they are in
+	QParallelCoordsData const *external;
+	bool outOfCore;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsDiskCache.h"
+
+ParallelCoordsDiskCache::ParallelCoordsDiskCache(QString dir_, qint64 maxBytes_)
+: dir(dir_), maxBytes(maxBytes_), totalBytes(0)
+{
+	QDir().mkpath(dir);
+
+	// Pick up what earlier sessions left, oldest first
+	QFileInfoList files = QDir(dir).entryInfoList(QStringList() << "*.png",
+		QDir::Files, QDir::Time | QDir::Reversed);
+	foreach(QFileInfo fi, files) {
+		lru.push_back(fi.fileName());
+		sizes.insert(fi.fileName(), fi.size());
+		totalBytes += fi.size();
+	}
+	evict();
+}
+
+ParallelCoordsDiskCache* ParallelCoordsDiskCache::instance()
+{
+	static QMutex instanceLock;
+	static ParallelCoordsDiskCache *cache = nullptr;
+
+	QMutexLocker locker(&instanceLock);
+	if(cache == nullptr) {
+		QString location = QDesktopServices::storageLocation(
+			QDesktopServices::CacheLocation);
+		cache = new ParallelCoordsDiskCache(location + "/tiles",
+			512 * 1024 * 1024);
+	}
+	return cache;
+}
+
+QString ParallelCoordsDiskCache::fileName(QByteArray const& key) const
+{
+	return QString(key.toHex()) + ".png";
+}
+
+QImage* ParallelCoordsDiskCache::load(QByteArray const& key)
+{
+	QString name = fileName(key);
+	{
+		QMutexLocker locker(&lock);
+		if(!sizes.contains(name))
+			return nullptr;
+		lru.removeOne(name);
+		lru.push_back(name);
+	}
+
+	QImage *img = new QImage();
+	if(!img->load(dir + "/" + name, "PNG")) {
+		delete img;
+		return nullptr;
+	}
+	return img;
+}
+
+void ParallelCoordsDiskCache::store(QByteArray const& key, QImage const& img)
+{
+	QtConcurrent::run(this, &ParallelCoordsDiskCache::write,
+		fileName(key), img);
+}
+
+void ParallelCoordsDiskCache::write(QString name, QImage img)
+{
+	// Written under a temporary name so a reader never sees half a file
+	QString path = dir + "/" + name;
+	if(!img.save(path + ".part", "PNG"))
+		return;
+	QFile::remove(path);
+	if(!QFile::rename(path + ".part", path))
+		return;
+
+	QMutexLocker locker(&lock);
+	if(sizes.contains(name)) {
+		totalBytes -= sizes[name];
+		lru.removeOne(name);
+	}
+	qint64 size = QFileInfo(path).size();
+	sizes.insert(name, size);
+	lru.push_back(name);
+	totalBytes += size;
+	evict();
+}
+
+void ParallelCoordsDiskCache::setMaxSize(qint64 bytes)
+{
+	QMutexLocker locker(&lock);
+	maxBytes = bytes;
+	evict();
+}
+
+void ParallelCoordsDiskCache::evict()
+{
+	while(totalBytes > maxBytes && !lru.isEmpty()) {
+		QString name = lru.takeFirst();
+		totalBytes -= sizes.take(name);
+		QFile::remove(dir + "/" + name);
+	}
+}
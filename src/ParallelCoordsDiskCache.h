@@ -0,0 +1,36 @@
+#ifndef __PARALLELCOORDSDISKCACHE_H__
+#define __PARALLELCOORDSDISKCACHE_H__
+
+#include "ParallelCoordinates.h"
+
+// Rendered tiles kept on disk between sessions. Tiles are stored as
+// png files named after their key, the least recently used ones are
+// removed once the directory grows beyond the size limit.
+class ParallelCoordsDiskCache
+{
+public:
+	ParallelCoordsDiskCache(QString dir, qint64 maxBytes);
+
+	// Shared by every view of the process
+	static ParallelCoordsDiskCache* instance();
+
+	// nullptr when the tile is not cached
+	QImage* load(QByteArray const& key);
+	// Writes in the background
+	void store(QByteArray const& key, QImage const& img);
+	void setMaxSize(qint64 bytes);
+
+private:
+	QString dir;
+	qint64 maxBytes;
+	qint64 totalBytes;
+	QList<QString> lru;				// least recently used first
+	QHash<QString, qint64> sizes;
+	QMutex lock;
+
+	QString fileName(QByteArray const& key) const;
+	void write(QString name, QImage img);
+	void evict();
+};
+
+#endif
@@ -0,0 +1,605 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsFilter.h"
+#include "QParallelCoordsData.h"
+#include <functional>
+
+// Vector kernels are compiled for their instruction set one function
+// at a time and only called when the cpu reports it, as in
+// ParallelCoordsProjection
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PC_FILTER_DISPATCH
+#include <immintrin.h>
+#endif
+
+// Compares x[i] with y[i], or with c when y is nullptr, and writes
+// one bit per row into whole words, bits past n are cleared
+typedef void (*compareKernel)(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out);
+
+// NaN fails every comparison, != included
+static bool compareValues(int op, qreal a, qreal b)
+{
+	if(qIsNaN(a) || qIsNaN(b))
+		return false;
+	switch(op) {
+	case ParallelCoordsFilter::Less: return a < b;
+	case ParallelCoordsFilter::LessEqual: return a <= b;
+	case ParallelCoordsFilter::Greater: return a > b;
+	case ParallelCoordsFilter::GreaterEqual: return a >= b;
+	case ParallelCoordsFilter::Equal: return a == b;
+	default: return a != b;
+	}
+}
+
+// The rows from first to n that did not fill a whole word
+static void compareTail(qreal const *x, qreal const *y, qreal c,
+	int first, int n, int op, quint64 *out)
+{
+	if(first >= n)
+		return;
+	quint64 bits = 0;
+	for(int i=first; i<n; i++) {
+		if(compareValues(op, x[i], y ? y[i] : c))
+			bits |= Q_UINT64_C(1) << (i - first);
+	}
+	out[first >> 6] = bits;
+}
+
+static void compareScalar(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out)
+{
+	int i = 0;
+	for(; i+64 <= n; i += 64)
+		compareTail(x + i, y ? y + i : nullptr, c, 0, 64, op, out + (i >> 6));
+	compareTail(x, y, c, i, n, op, out);
+}
+
+#ifdef PC_FILTER_DISPATCH
+
+// The ordered predicates, false when either side is NaN. cmpneq is
+// the one unordered compare of sse2, it is masked with cmpord.
+template <int op>
+__attribute__((target("sse2")))
+static inline __m128d compareSse2(__m128d a, __m128d b)
+{
+	switch(op) {
+	case ParallelCoordsFilter::Less: return _mm_cmplt_pd(a, b);
+	case ParallelCoordsFilter::LessEqual: return _mm_cmple_pd(a, b);
+	case ParallelCoordsFilter::Greater: return _mm_cmpgt_pd(a, b);
+	case ParallelCoordsFilter::GreaterEqual: return _mm_cmpge_pd(a, b);
+	case ParallelCoordsFilter::Equal: return _mm_cmpeq_pd(a, b);
+	default: return _mm_and_pd(_mm_cmpneq_pd(a, b), _mm_cmpord_pd(a, b));
+	}
+}
+
+template <int op, bool columns>
+__attribute__((target("sse2")))
+static void compareSse2Op(qreal const *x, qreal const *y, qreal c,
+	int n, quint64 *out)
+{
+	double const *a = reinterpret_cast<double const*>(x);
+	double const *b = reinterpret_cast<double const*>(y);
+	const __m128d vc = _mm_set1_pd(c);
+	int i = 0;
+	for(; i+64 <= n; i += 64) {
+		quint64 bits = 0;
+		for(int k=0; k<64; k+=2) {
+			__m128d r = compareSse2<op>(_mm_loadu_pd(a+i+k),
+				columns ? _mm_loadu_pd(b+i+k) : vc);
+			bits |= static_cast<quint64>(_mm_movemask_pd(r)) << k;
+		}
+		out[i >> 6] = bits;
+	}
+	compareTail(x, y, c, i, n, op, out);
+}
+
+template <int pred, bool columns>
+__attribute__((target("avx")))
+static void compareAvxOp(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out)
+{
+	double const *a = reinterpret_cast<double const*>(x);
+	double const *b = reinterpret_cast<double const*>(y);
+	const __m256d vc = _mm256_set1_pd(c);
+	int i = 0;
+	for(; i+64 <= n; i += 64) {
+		quint64 bits = 0;
+		for(int k=0; k<64; k+=4) {
+			__m256d r = _mm256_cmp_pd(_mm256_loadu_pd(a+i+k),
+				columns ? _mm256_loadu_pd(b+i+k) : vc, pred);
+			bits |= static_cast<quint64>(_mm256_movemask_pd(r)) << k;
+		}
+		out[i >> 6] = bits;
+	}
+	compareTail(x, y, c, i, n, op, out);
+}
+
+template <bool columns>
+static void compareSse2Columns(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out)
+{
+	switch(op) {
+	case ParallelCoordsFilter::Less:
+		compareSse2Op<ParallelCoordsFilter::Less, columns>(x, y, c, n, out); break;
+	case ParallelCoordsFilter::LessEqual:
+		compareSse2Op<ParallelCoordsFilter::LessEqual, columns>(x, y, c, n, out); break;
+	case ParallelCoordsFilter::Greater:
+		compareSse2Op<ParallelCoordsFilter::Greater, columns>(x, y, c, n, out); break;
+	case ParallelCoordsFilter::GreaterEqual:
+		compareSse2Op<ParallelCoordsFilter::GreaterEqual, columns>(x, y, c, n, out); break;
+	case ParallelCoordsFilter::Equal:
+		compareSse2Op<ParallelCoordsFilter::Equal, columns>(x, y, c, n, out); break;
+	default:
+		compareSse2Op<ParallelCoordsFilter::NotEqual, columns>(x, y, c, n, out); break;
+	}
+}
+
+template <bool columns>
+static void compareAvxColumns(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out)
+{
+	switch(op) {
+	case ParallelCoordsFilter::Less:
+		compareAvxOp<_CMP_LT_OQ, columns>(x, y, c, n, op, out); break;
+	case ParallelCoordsFilter::LessEqual:
+		compareAvxOp<_CMP_LE_OQ, columns>(x, y, c, n, op, out); break;
+	case ParallelCoordsFilter::Greater:
+		compareAvxOp<_CMP_GT_OQ, columns>(x, y, c, n, op, out); break;
+	case ParallelCoordsFilter::GreaterEqual:
+		compareAvxOp<_CMP_GE_OQ, columns>(x, y, c, n, op, out); break;
+	case ParallelCoordsFilter::Equal:
+		compareAvxOp<_CMP_EQ_OQ, columns>(x, y, c, n, op, out); break;
+	default:
+		compareAvxOp<_CMP_NEQ_OQ, columns>(x, y, c, n, op, out); break;
+	}
+}
+
+static void compareSse2Kernel(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out)
+{
+	if(y)
+		compareSse2Columns<true>(x, y, c, n, op, out);
+	else
+		compareSse2Columns<false>(x, y, c, n, op, out);
+}
+
+static void compareAvxKernel(qreal const *x, qreal const *y, qreal c,
+	int n, int op, quint64 *out)
+{
+	if(y)
+		compareAvxColumns<true>(x, y, c, n, op, out);
+	else
+		compareAvxColumns<false>(x, y, c, n, op, out);
+}
+
+#endif
+
+namespace {
+
+struct kernelChoice {
+	compareKernel kernel;
+	char const *name;
+};
+
+kernelChoice chooseKernel()
+{
+	kernelChoice choice = {compareScalar, "scalar"};
+#ifdef PC_FILTER_DISPATCH
+	// qreal is float on some embedded builds of Qt
+	if(sizeof(qreal) != sizeof(double))
+		return choice;
+
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx")) {
+		choice.kernel = compareAvxKernel;
+		choice.name = "avx";
+	}
+	else if(__builtin_cpu_supports("sse2")) {
+		choice.kernel = compareSse2Kernel;
+		choice.name = "sse2";
+	}
+#endif
+	return choice;
+}
+
+kernelChoice const& kernel()
+{
+	static const kernelChoice choice = chooseKernel();
+	return choice;
+}
+
+struct rowRange {
+	int begin;
+	int end;
+};
+
+}
+
+// Bits of word w that stand for one of count rows
+static quint64 wordMask(int count, int w)
+{
+	const int rows = count - w * 64;
+	return rows >= 64 ? ~Q_UINT64_C(0) : (Q_UINT64_C(1) << rows) - 1;
+}
+
+static void selectRange(rowRange range, ParallelCoordsFilter const *filter,
+	ParallelCoordsDataSnapshot const *data, quint64 *words)
+{
+	filter->evaluate(data, range.begin, range.end - range.begin,
+		words + (range.begin >> 6));
+}
+
+ParallelCoordsFilter::ParallelCoordsFilter()
+: root(-1), pos(0), parseData(nullptr)
+{
+}
+
+QString ParallelCoordsFilter::errorString() const
+{
+	return error;
+}
+
+QString ParallelCoordsFilter::text() const
+{
+	return source;
+}
+
+bool ParallelCoordsFilter::missesCategories(int axis) const
+{
+	return unknownCategoryAxes.contains(axis);
+}
+
+char const* ParallelCoordsFilter::kernelName()
+{
+	return kernel().name;
+}
+
+void ParallelCoordsFilter::fail(QString message)
+{
+	// the first error is the one that explains it
+	if(error.isEmpty())
+		error = message;
+}
+
+bool ParallelCoordsFilter::tokenize(QString text)
+{
+	static const char *pairs[] = {"&&", "||", "<=", ">=", "==", "!="};
+	tokens.clear();
+	const int len = text.length();
+	int i = 0;
+	while(i < len) {
+		const QChar ch = text[i];
+		int j = i + 1;
+		if(ch.isSpace()) {
+			i++;
+			continue;
+		}
+		if(ch.isLetter() || ch == '_') {
+			while(j < len && (text[j].isLetterOrNumber() || text[j] == '_' ||
+				  text[j] == '.'))
+				j++;
+		}
+		else if(ch.isDigit() || ch == '.') {
+			while(j < len && (text[j].isDigit() || text[j] == '.'))
+				j++;
+			if(j < len && (text[j] == 'e' || text[j] == 'E')) {
+				j++;
+				if(j < len && (text[j] == '+' || text[j] == '-'))
+					j++;
+				while(j < len && text[j].isDigit())
+					j++;
+			}
+		}
+		else if(ch == '`' || ch == '"' || ch == '\'') {
+			j = text.indexOf(ch, i + 1);
+			if(j < 0) {
+				fail(QString("Missing closing %1").arg(ch));
+				return false;
+			}
+			j++;
+		}
+		else {
+			bool pair = false;
+			for(int p=0; p<6 && !pair; p++)
+				pair = text.mid(i, 2) == pairs[p];
+			if(pair)
+				j = i + 2;
+			else if(!QString("<>!()-").contains(ch)) {
+				fail(QString("Unexpected %1").arg(ch));
+				return false;
+			}
+		}
+		tokens << text.mid(i, j - i);
+		i = j;
+	}
+	return true;
+}
+
+int ParallelCoordsFilter::addNode(node const& n)
+{
+	nodes.push_back(n);
+	return nodes.count() - 1;
+}
+
+bool ParallelCoordsFilter::compile(QString text, QParallelCoordsData const *data)
+{
+	source = text;
+	error.clear();
+	nodes.clear();
+	unknownCategoryAxes.clear();
+	root = -1;
+	parseData = data;
+	pos = 0;
+
+	if(tokenize(text)) {
+		root = parseOr(false);
+		if(root >= 0 && pos < tokens.count()) {
+			fail(QString("Unexpected %1").arg(tokens[pos]));
+			root = -1;
+		}
+	}
+	tokens.clear();
+	parseData = nullptr;
+	return root >= 0;
+}
+
+int ParallelCoordsFilter::parseOr(bool negated)
+{
+	int left = parseAnd(negated);
+	while(left >= 0 && pos < tokens.count() && tokens[pos] == "||") {
+		pos++;
+		const int right = parseAnd(negated);
+		if(right < 0)
+			return -1;
+		// !(a || b) is !a && !b
+		node n = {negated ? And : Or, Less, -1, -1, 0, false, left, right};
+		left = addNode(n);
+	}
+	return left;
+}
+
+int ParallelCoordsFilter::parseAnd(bool negated)
+{
+	int left = parseUnary(negated);
+	while(left >= 0 && pos < tokens.count() && tokens[pos] == "&&") {
+		pos++;
+		const int right = parseUnary(negated);
+		if(right < 0)
+			return -1;
+		node n = {negated ? Or : And, Less, -1, -1, 0, false, left, right};
+		left = addNode(n);
+	}
+	return left;
+}
+
+int ParallelCoordsFilter::parseUnary(bool negated)
+{
+	if(pos >= tokens.count()) {
+		fail("The filter ends early");
+		return -1;
+	}
+	if(tokens[pos] == "!") {
+		pos++;
+		return parseUnary(!negated);
+	}
+	if(tokens[pos] == "(") {
+		pos++;
+		const int idx = parseOr(negated);
+		if(idx < 0)
+			return -1;
+		if(pos >= tokens.count() || tokens[pos] != ")") {
+			fail("Missing )");
+			return -1;
+		}
+		pos++;
+		return idx;
+	}
+	return parseComparison(negated);
+}
+
+bool ParallelCoordsFilter::parseOperand(operand &o)
+{
+	o.axis = -1;
+	o.value = 0;
+	o.isCategory = false;
+	if(pos >= tokens.count()) {
+		fail("The filter ends early");
+		return false;
+	}
+
+	QString t = tokens[pos++];
+	qreal sign = 1;
+	if(t == "-" && pos < tokens.count()) {
+		sign = -1;
+		t = tokens[pos++];
+	}
+
+	const QChar first = t[0];
+	if(first.isDigit() || first == '.') {
+		bool ok;
+		o.value = sign * t.toDouble(&ok);
+		if(!ok)
+			fail(QString("%1 is not a number").arg(t));
+		return ok;
+	}
+	if(sign < 0) {
+		fail(QString("Expected a number after -, not %1").arg(t));
+		return false;
+	}
+	if(first == '"' || first == '\'') {
+		o.isCategory = true;
+		o.category = t.mid(1, t.length() - 2);
+		return true;
+	}
+
+	const QString name = first == '`' ? t.mid(1, t.length() - 2) : t;
+	for(int a=0; a<parseData->axis_count() && o.axis<0; a++) {
+		if(parseData->getAxisName(a) == name)
+			o.axis = a;
+	}
+	if(o.axis < 0) {
+		fail(QString("There is no axis %1").arg(name));
+		return false;
+	}
+	return true;
+}
+
+int ParallelCoordsFilter::parseComparison(bool negated)
+{
+	static const char *ops[] = {"<", "<=", ">", ">=", "==", "!="};
+	// operands swapped, and the comparison negated
+	static const Op mirrored[] = {Greater, GreaterEqual, Less, LessEqual,
+		Equal, NotEqual};
+	static const Op inverse[] = {GreaterEqual, Greater, LessEqual, Less,
+		NotEqual, Equal};
+
+	operand a, b;
+	if(!parseOperand(a))
+		return -1;
+	int op = -1;
+	for(int i=0; i<6 && pos<tokens.count(); i++) {
+		if(tokens[pos] == ops[i])
+			op = i;
+	}
+	if(op < 0) {
+		fail("Expected a comparison");
+		return -1;
+	}
+	pos++;
+	if(!parseOperand(b))
+		return -1;
+
+	// The axis goes on the left
+	if(a.axis < 0 && b.axis >= 0) {
+		qSwap(a, b);
+		op = mirrored[op];
+	}
+	// Negated comparisons are their inverse, a missing value fails
+	// both, which is what !(x > 1) means for a row without x
+	if(negated)
+		op = inverse[op];
+
+	node n = {Compare, static_cast<Op>(op), a.axis, -1, 0, false, -1, -1};
+	if(a.isCategory || (b.isCategory && a.axis < 0)) {
+		fail("A category can only be compared to its axis");
+		return -1;
+	}
+	if(a.axis < 0) {
+		// nothing to look at, decided here
+		n.type = Constant;
+		n.truth = compareValues(op, a.value, b.value);
+	}
+	else if(b.axis >= 0) {
+		n.otherAxis = b.axis;
+	}
+	else if(b.isCategory) {
+		if(parseData->getAxisType(a.axis) != QParallelCoordsData::Categorical) {
+			fail(QString("%1 has no categories")
+				.arg(parseData->getAxisName(a.axis)));
+			return -1;
+		}
+		// codes count from 0, -1 is a category no row has
+		n.value = -1;
+		for(int code=0; code<parseData->categoryCount(a.axis); code++) {
+			if(parseData->categoryName(a.axis, code) == b.category) {
+				n.value = code;
+				break;
+			}
+		}
+		if(n.value < 0 && !unknownCategoryAxes.contains(a.axis))
+			unknownCategoryAxes.push_back(a.axis);
+	}
+	else {
+		n.value = b.value;
+	}
+	return addNode(n);
+}
+
+void ParallelCoordsFilter::evaluate(ParallelCoordsDataSnapshot const *data,
+	int first, int count, quint64 *out) const
+{
+	Q_ASSERT((first & 63) == 0);
+	if(root < 0)
+		return;
+	QVector<qreal> leftBuffer, rightBuffer;
+	const int block = blockRows;
+	for(int done=0; done<count; done+=block) {
+		evaluateNode(root, data, first + done, qMin(block, count - done),
+			out + (done >> 6), leftBuffer, rightBuffer);
+	}
+}
+
+void ParallelCoordsFilter::evaluateNode(int idx,
+	ParallelCoordsDataSnapshot const *data, int first, int count,
+	quint64 *out, QVector<qreal> &leftBuffer, QVector<qreal> &rightBuffer) const
+{
+	node const& n = nodes[idx];
+	const int words = (count + 63) / 64;
+
+	if(n.type == Constant) {
+		for(int w=0; w<words; w++)
+			out[w] = n.truth ? wordMask(count, w) : 0;
+		return;
+	}
+
+	if(n.type == Compare) {
+		qreal const *x = data->columnChunk(n.axis, first, count, leftBuffer);
+		qreal const *y = n.otherAxis < 0 ? nullptr :
+			data->columnChunk(n.otherAxis, first, count, rightBuffer);
+		kernel().kernel(x, y, n.value, count, n.op, out);
+		return;
+	}
+
+	// The right side is skipped when the left one already decides
+	// every row of the block
+	evaluateNode(n.left, data, first, count, out, leftBuffer, rightBuffer);
+	bool decided = true;
+	for(int w=0; w<words && decided; w++)
+		decided = out[w] == (n.type == And ? 0 : wordMask(count, w));
+	if(decided)
+		return;
+
+	quint64 other[blockRows / 64];
+	evaluateNode(n.right, data, first, count, other, leftBuffer, rightBuffer);
+	if(n.type == And) {
+		for(int w=0; w<words; w++)
+			out[w] &= other[w];
+	}
+	else {
+		for(int w=0; w<words; w++)
+			out[w] |= other[w];
+	}
+}
+
+ParallelCoordsRowMask ParallelCoordsFilter::select(
+	ParallelCoordsDataSnapshot const *data, ParallelCoordsRowMask previous) const
+{
+	const int rowCnt = data->length();
+	rowMask *mask = new rowMask;
+	int first = 0;
+	if(previous) {
+		// its last word may have been cut short by the rows back then
+		mask->words = previous->words;
+		first = qMin(qMax(mask->words.count() - 1, 0) * 64, rowCnt & ~63);
+	}
+	mask->words.resize((rowCnt + 63) / 64);
+
+	// Ranges end on segment boundaries so chunks are read in place,
+	// each range owns its words of the mask
+	QList<rowRange> ranges;
+	const int rangeRows = ParallelCoordsDataSnapshot::segmentRows;
+	for(int begin=first; begin<rowCnt; ) {
+		rowRange r = {begin, qMin((begin / rangeRows + 1) * rangeRows, rowCnt)};
+		ranges.push_back(r);
+		begin = r.end;
+	}
+	using namespace std::placeholders;
+	QtConcurrent::blockingMap(ranges, std::bind(selectRange, _1, this, data,
+		mask->words.data()));
+
+	QCryptographicHash h(QCryptographicHash::Sha1);
+	h.addData(data->contentHash());
+	h.addData(source.trimmed().toUtf8());
+	mask->hash = h.result();
+	return ParallelCoordsRowMask(mask);
+}
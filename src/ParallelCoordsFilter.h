@@ -0,0 +1,96 @@
+#ifndef __PARALLELCOORDSFILTER_H__
+#define __PARALLELCOORDSFILTER_H__
+
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsDataSnapshot.h"
+
+class QParallelCoordsData;
+
+// A row filter such as `latency > 200 && region == "EU"`. Comparisons
+// of an axis with a number, a category in quotes or another axis are
+// joined by &&, || and ! with parentheses. Names that are not plain
+// identifiers go in backquotes.
+//
+// The text is parsed once into a tree evaluated a block of rows at a
+// time. Each comparison runs over one column with the widest vector
+// unit the cpu has and yields a bit per row, the bits are then
+// combined word by word. Negations are pushed down to the comparisons
+// while parsing, and a comparison with a missing value is false, so a
+// missing value never makes a row match.
+class ParallelCoordsFilter
+{
+public:
+	enum Op { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+	ParallelCoordsFilter();
+
+	// Names and categories are looked up in data now, a category not
+	// among them yet is one no row has. False with errorString() set
+	// if text does not parse.
+	bool compile(QString text, QParallelCoordsData const *data);
+	QString errorString() const;
+	QString text() const;
+	// A category of axis was not known to data when compiled, the
+	// filter has to be compiled again once it may be
+	bool missesCategories(int axis) const;
+
+	// Sets the bits of the matching rows among count rows from first,
+	// which has to be a multiple of 64
+	void evaluate(ParallelCoordsDataSnapshot const *data, int first,
+		int count, quint64 *out) const;
+	// The matching rows of data on all cores. Rows are never changed
+	// once in, so only the ones after those of previous are evaluated.
+	ParallelCoordsRowMask select(ParallelCoordsDataSnapshot const *data,
+		ParallelCoordsRowMask previous = ParallelCoordsRowMask()) const;
+
+	// sse2, avx or scalar
+	static char const* kernelName();
+
+private:
+	enum NodeType { And, Or, Compare, Constant };
+
+	struct node {
+		NodeType type;
+		Op op;
+		int axis;
+		int otherAxis;		// compared to value when -1
+		qreal value;
+		bool truth;			// of a constant
+		int left;			// children of And and Or
+		int right;
+	};
+
+	// One operand of a comparison as parsed
+	struct operand {
+		int axis;
+		qreal value;
+		QString category;
+		bool isCategory;
+	};
+
+	QString source;
+	QString error;
+	QVector<node> nodes;
+	int root;
+	QVector<int> unknownCategoryAxes;
+	static const int blockRows = 4096;		// rows evaluated together
+
+	// Recursive descent over the tokens, negated flips what is built
+	QStringList tokens;
+	int pos;
+	QParallelCoordsData const *parseData;
+	int parseOr(bool negated);
+	int parseAnd(bool negated);
+	int parseUnary(bool negated);
+	int parseComparison(bool negated);
+	bool parseOperand(operand &o);
+	int addNode(node const& n);
+	bool tokenize(QString text);
+	void fail(QString message);
+
+	void evaluateNode(int idx, ParallelCoordsDataSnapshot const *data,
+		int first, int count, quint64 *out,
+		QVector<qreal> &leftBuffer, QVector<qreal> &rightBuffer) const;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsLoader.h"
+#include "QParallelCoordsData.h"
+#include <limits>
+
+ParallelCoordsLoader::ParallelCoordsLoader(QString fname_)
+: fname(fname_), cancelled(false)
+{
+	firstBatchRows = 10000;
+	maxBatchRows = 1000000;
+	maxBatchMsecs = 1000;
+	typeSampleRows = 1000;
+
+	qRegisterMetaType<ParallelCoordsRowBatch>("ParallelCoordsRowBatch");
+	qRegisterMetaType<QVector<int>>("QVector<int>");
+}
+
+// A column is categorical as soon as one of its sampled fields is not
+// a number. Empty fields are missing values and say nothing.
+QVector<int> ParallelCoordsLoader::inferTypes(QList<QString> const& lines,
+	int axisCnt) const
+{
+	QVector<int> types(axisCnt, QParallelCoordsData::Numeric);
+	foreach(QString line, lines) {
+		QStringList fields = line.split(",");
+		for(int i=0; i<qMin(axisCnt, fields.count()); i++) {
+			QString field = fields[i].trimmed();
+			bool ok = true;
+			if(!field.isEmpty())
+				field.toDouble(&ok);
+			if(!ok)
+				types[i] = QParallelCoordsData::Categorical;
+		}
+	}
+	return types;
+}
+
+void ParallelCoordsLoader::cancel()
+{
+	cancelled = true;
+}
+
+void ParallelCoordsLoader::load()
+{
+	QFile inpFile(fname);
+	if(!inpFile.open(QIODevice::ReadOnly)) {
+		emit failed(QString("Could not open %1: %2").arg(fname)
+			.arg(inpFile.errorString()));
+		emit finished(false, 0);
+		return;
+	}
+
+	const qint64 fileSize = qMax(inpFile.size(), static_cast<qint64>(1));
+	QTextStream txtStrm(&inpFile);
+	QString inp = txtStrm.readLine();
+	// Fields are matched to names by position, so a column without a
+	// name still gets an axis
+	QStringList axisNames = inp.split(",");
+	int axisCnt = axisNames.count();
+	for(int i=0; i<axisCnt; i++) {
+		if(axisNames[i].trimmed().isEmpty())
+			axisNames[i] = QString("Column %1").arg(i+1);
+	}
+
+	// Types are guessed from the first rows, which are kept around and
+	// parsed again below
+	QList<QString> sample;
+	inp = txtStrm.readLine();
+	while(!inp.isEmpty() && sample.count() < typeSampleRows) {
+		sample.push_back(inp);
+		inp = txtStrm.readLine();
+	}
+	QVector<int> types = inferTypes(sample, axisCnt);
+	emit header(axisNames, types);
+
+	QVector<QHash<QString, int>> dictionaries(axisCnt);
+	QVector<QStringList> newCategories(axisCnt);
+	const qreal missing = std::numeric_limits<qreal>::quiet_NaN();
+	qint64 droppedFields = 0;
+
+	// A batch is published when it is full or has been filling for too
+	// long, whichever comes first. Every batch may be twice as large
+	// as the one before.
+	int batchRows = firstBatchRows;
+	int lastPercent = -1;
+	QElapsedTimer batchTimer;
+	batchTimer.start();
+
+	ParallelCoordsRowBatch pts;
+	while((!sample.isEmpty() || !inp.isEmpty()) && !cancelled) {
+		QString line;
+		if(!sample.isEmpty()) {
+			line = sample.takeFirst();
+		}
+		else {
+			line = inp;
+			inp = txtStrm.readLine();
+		}
+
+		// Empty and absent fields are missing values
+		QVector<qreal> pt(axisCnt, missing);
+		QStringList inpList = line.split(",");
+		for(int i=0; i<qMin(axisCnt, inpList.count()); i++) {
+			QString field = inpList[i].trimmed();
+			if(field.isEmpty())
+				continue;
+
+			if(types[i] == QParallelCoordsData::Numeric) {
+				bool ok;
+				qreal v = field.toDouble(&ok);
+				pt[i] = ok ? v : missing;
+				if(!ok)
+					droppedFields++;
+				continue;
+			}
+			QHash<QString, int>::const_iterator code = dictionaries[i].constFind(field);
+			if(code == dictionaries[i].constEnd()) {
+				code = dictionaries[i].insert(field, dictionaries[i].count());
+				newCategories[i].push_back(field);
+			}
+			pt[i] = code.value();
+		}
+		pts.push_back(pt);
+
+		if(pts.count() >= batchRows ||
+		   ((pts.count() & 1023) == 0 && batchTimer.elapsed() > maxBatchMsecs)) {
+			for(int i=0; i<axisCnt; i++) {
+				if(!newCategories[i].isEmpty())
+					emit categoriesAdded(i, newCategories[i]);
+				newCategories[i].clear();
+			}
+			emit batchReady(pts);
+			pts.clear();
+			batchRows = qMin(batchRows * 2, maxBatchRows);
+			batchTimer.restart();
+
+			int percent = inpFile.pos() * 100 / fileSize;
+			if(percent != lastPercent) {
+				lastPercent = percent;
+				emit progress(percent);
+			}
+		}
+	}
+
+	if(!pts.isEmpty()) {
+		for(int i=0; i<axisCnt; i++) {
+			if(!newCategories[i].isEmpty())
+				emit categoriesAdded(i, newCategories[i]);
+		}
+		emit batchReady(pts);
+	}
+	emit progress(100);
+	emit finished(cancelled, droppedFields);
+}
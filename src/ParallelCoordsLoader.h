@@ -0,0 +1,49 @@
+#ifndef __PARALLELCOORDSLOADER_H__
+#define __PARALLELCOORDSLOADER_H__
+
+#include "ParallelCoordinates.h"
+#include <atomic>
+
+typedef QList<QVector<qreal>> ParallelCoordsRowBatch;
+
+// Reads a csv file on a worker thread and hands the rows over in
+// batches. Batches start small so something is on screen early and
+// grow as the load goes on.
+class ParallelCoordsLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	ParallelCoordsLoader(QString fname);
+
+	// Thread safe, the loader stops at the next batch boundary
+	void cancel();
+
+public slots:
+	void load();
+
+signals:
+	// axisTypes holds a QParallelCoordsData::AxisType per axis
+	void header(QStringList axisNames, QVector<int> axisTypes);
+	// Sent before the batch that first uses the new codes
+	void categoriesAdded(int axis, QStringList names);
+	void batchReady(ParallelCoordsRowBatch rows);
+	void progress(int percent);
+	// Sent before finished when the file could not be read
+	void failed(QString message);
+	// droppedFields counts the fields of numeric axes past the sampled
+	// rows that were not numbers and are stored as missing values
+	void finished(bool cancelled, qint64 droppedFields);
+
+private:
+	QString fname;
+	std::atomic<bool> cancelled;
+	int firstBatchRows;
+	int maxBatchRows;
+	int maxBatchMsecs;
+	int typeSampleRows;
+
+	QVector<int> inferTypes(QList<QString> const& lines, int axisCnt) const;
+};
+
+#endif
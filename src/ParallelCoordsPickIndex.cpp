@@ -0,0 +1,182 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsPickIndex.h"
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+// Cell of the rows left out of the index
+static const quint16 noCell = 0xffff;
+
+static int bucketOf(renderData const& rd, qreal y, int bucketCnt)
+{
+	int b = static_cast<int>((y - rd.axis_y) * bucketCnt / rd.axis_height);
+	return qBound(0, b, bucketCnt-1);
+}
+
+ParallelCoordsPickIndex::ParallelCoordsPickIndex(
+	ParallelCoordsDataSnapshot::pointer data_)
+: data(data_)
+{
+	bucketCnt = buckets;
+}
+
+void ParallelCoordsPickIndex::bucketChunk(pairIndex &pair, int bucketCnt,
+	renderChunk const *chunk)
+{
+	const int rowCnt = chunk->rowCnt;
+	quint16 *cell = pair.cell.data() + chunk->firstRow;
+	qreal const *yl = chunk->ys + pair.slot * rowCnt;
+	qreal const *yr = yl + rowCnt;
+	const int words = (rowCnt + 63) / 64;
+	quint64 const *dl = chunk->drawn + pair.slot * words;
+	quint64 const *dr = dl + words;
+	for(int i=0; i<rowCnt; i++) {
+		// rows not drawn never match a pick and are left out
+		if(!((dl[i >> 6] & dr[i >> 6]) >> (i & 63) & 1) ||
+		   qIsNaN(yl[i]) || qIsNaN(yr[i])) {
+			cell[i] = noCell;
+			continue;
+		}
+		cell[i] = bucketOf(pair.left, yl[i], bucketCnt) * bucketCnt +
+			bucketOf(pair.right, yr[i], bucketCnt);
+	}
+}
+
+void ParallelCoordsPickIndex::sortPair(pairIndex &pair, int bucketCnt)
+{
+	// Counting sort of the rows on their cell
+	const int rowCnt = pair.cell.count();
+	const int cellCnt = bucketCnt * bucketCnt;
+	pair.cellStart.fill(0, cellCnt + 1);
+	for(int i=0; i<rowCnt; i++) {
+		if(pair.cell[i] != noCell)
+			pair.cellStart[pair.cell[i]+1]++;
+	}
+	for(int c=0; c<cellCnt; c++)
+		pair.cellStart[c+1] += pair.cellStart[c];
+
+	QVector<int> fill(pair.cellStart);
+	pair.rows.resize(pair.cellStart[cellCnt]);
+	for(int i=0; i<rowCnt; i++) {
+		if(pair.cell[i] != noCell)
+			pair.rows[fill[pair.cell[i]]++] = i;
+	}
+	pair.cell = QVector<quint16>();
+}
+
+void ParallelCoordsPickIndex::begin(QVector<renderData> const& ppd, int rowCnt)
+{
+	pairs.clear();
+	for(int j=0; j+1<ppd.count(); j++) {
+		pairIndex pair;
+		pair.slot = j;
+		pair.left = ppd[j];
+		pair.right = ppd[j+1];
+		pair.cell.resize(rowCnt);
+		pairs.push_back(pair);
+	}
+}
+
+void ParallelCoordsPickIndex::addChunk(renderChunk const& chunk)
+{
+	using namespace std::placeholders;
+	QtConcurrent::blockingMap(pairs,
+		std::bind(bucketChunk, _1, bucketCnt, &chunk));
+}
+
+void ParallelCoordsPickIndex::finish()
+{
+	using namespace std::placeholders;
+	QtConcurrent::blockingMap(pairs, std::bind(sortPair, _1, bucketCnt));
+}
+
+qint64 ParallelCoordsPickIndex::bytes() const
+{
+	qint64 b = 0;
+	foreach(pairIndex const& p, pairs) {
+		b += p.cell.count() * sizeof(quint16) +
+			(p.cellStart.count() + p.rows.count()) * sizeof(int);
+	}
+	return b;
+}
+
+qint64 ParallelCoordsPickIndex::buildBytes(int pairCnt, int rowCnt)
+{
+	// cells and rows are both alive while a pair is sorted
+	return static_cast<qint64>(pairCnt) * (static_cast<qint64>(rowCnt) *
+		(sizeof(quint16) + sizeof(int)) +
+		(buckets * buckets + 1) * sizeof(int));
+}
+
+qreal ParallelCoordsPickIndex::project(renderData const& rd, int row) const
+{
+	return (data->value(row, rd.index) - rd.data_min) * rd.axis_height /
+		(rd.data_max - rd.data_min) + rd.axis_y;
+}
+
+QVector<int> ParallelCoordsPickIndex::pick(QPointF pt, qreal tolerance,
+	int maxRows) const
+{
+	QVector<int> result;
+
+	// find the pair of axes the point lies between
+	pairIndex const *pair = nullptr;
+	foreach(pairIndex const& p, pairs) {
+		if(p.left.axis_x <= pt.x() && pt.x() <= p.right.axis_x) {
+			pair = &p;
+			break;
+		}
+	}
+	if(pair == nullptr || pair->rows.isEmpty())
+		return result;
+
+	// A segment at parameter t has y = yl(1-t) + yr t. For a cell with
+	// yl in [a, a+hl] and yr in [b, b+hr] that y lies within
+	// [a(1-t) + b t, a(1-t) + b t + hl(1-t) + hr t]. Walk the left
+	// buckets and only visit the right buckets that can reach pt.
+	const qreal t = (pt.x() - pair->left.axis_x) /
+		(pair->right.axis_x - pair->left.axis_x);
+	const qreal hl = pair->left.axis_height / bucketCnt;
+	const qreal hr = pair->right.axis_height / bucketCnt;
+	const qreal reach = hl * (1-t) + hr * t;
+
+	QVector<QPair<qreal, int>> hits;
+	for(int i=0; i<bucketCnt; i++) {
+		const qreal a = pair->left.axis_y + i * hl;
+		int jFirst = 0, jLast = bucketCnt-1;
+		if(t > 0) {
+			// solve a(1-t) + b t within [pt.y - tol - reach, pt.y + tol]
+			qreal bLow = (pt.y() - tolerance - reach - a*(1-t)) / t;
+			qreal bHigh = (pt.y() + tolerance - a*(1-t)) / t;
+			// Near the left axis t is tiny and the bounds huge, they
+			// are clamped before they can overflow an int. Out of range
+			// on either side leaves jFirst > jLast.
+			jFirst = static_cast<int>(qBound(0.0,
+				std::floor((bLow - pair->right.axis_y) / hr),
+				static_cast<qreal>(bucketCnt)));
+			jLast = static_cast<int>(qBound(-1.0,
+				std::floor((bHigh - pair->right.axis_y) / hr),
+				static_cast<qreal>(bucketCnt-1)));
+		}
+		else if(a + hl < pt.y() - tolerance || a > pt.y() + tolerance) {
+			continue;
+		}
+
+		for(int j=jFirst; j<=jLast; j++) {
+			const int c = i * bucketCnt + j;
+			for(int k=pair->cellStart[c]; k<pair->cellStart[c+1]; k++) {
+				const int row = pair->rows[k];
+				qreal y = project(pair->left, row) * (1-t) +
+					project(pair->right, row) * t;
+				qreal d = qAbs(y - pt.y());
+				if(d <= tolerance)
+					hits.push_back(qMakePair(d, row));
+			}
+		}
+	}
+
+	std::sort(hits.begin(), hits.end());
+	for(int i=0; i<hits.count() && i<maxRows; i++)
+		result.push_back(hits[i].second);
+	return result;
+}
@@ -0,0 +1,51 @@
+#ifndef __PARALLELCOORDSPICKINDEX_H__
+#define __PARALLELCOORDSPICKINDEX_H__
+
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsDataSnapshot.h"
+#include "ParallelCoordsViewPrivate.h"
+
+// Screen space index of the segments of one tile. For every pair of
+// neighbouring axes the rows are bucketed on a grid of (left y, right y)
+// cells so a pick only has to test the rows of the few cells whose
+// segments can pass near the point. Rows hidden by the filter or the
+// mask of the view, or missing a value on either axis, are left out.
+class ParallelCoordsPickIndex
+{
+public:
+	// Picks read the rows of the data the tile was rendered from
+	ParallelCoordsPickIndex(ParallelCoordsDataSnapshot::pointer data);
+
+	// Built chunk by chunk as the tile is rendered
+	void begin(QVector<renderData> const& ppd, int rowCnt);
+	void addChunk(renderChunk const& chunk);
+	void finish();
+	// Rows passing within tolerance (canvas units) of pt, nearest first
+	QVector<int> pick(QPointF pt, qreal tolerance, int maxRows) const;
+	// Memory held now, and at most while an index of pairCnt pairs
+	// of rowCnt rows is built
+	qint64 bytes() const;
+	static qint64 buildBytes(int pairCnt, int rowCnt);
+
+private:
+	struct pairIndex {
+		int slot;				// position of the left axis in the chunks
+		renderData left;
+		renderData right;
+		QVector<quint16> cell;	// per row, only while building
+		QVector<int> cellStart;	// bucketCnt*bucketCnt+1 offsets into rows
+		QVector<int> rows;
+	};
+
+	ParallelCoordsDataSnapshot::pointer data;
+	QVector<pairIndex> pairs;
+	int bucketCnt;
+	static const int buckets = 255;		// cells and noCell fit in a quint16
+
+	qreal project(renderData const& rd, int row) const;
+	static void bucketChunk(pairIndex &pair, int bucketCnt,
+		renderChunk const *chunk);
+	static void sortPair(pairIndex &pair, int bucketCnt);
+};
+
+#endif
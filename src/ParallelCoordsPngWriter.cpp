@@ -0,0 +1,133 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsPngWriter.h"
+#include <cstring>
+
+ParallelCoordsPngWriter::ParallelCoordsPngWriter(QIODevice *device_,
+	QSize size_)
+: device(device_), size(size_)
+{
+	rowsWritten = 0;
+	started = false;
+	idatSize = 1 << 18;
+	memset(&strm, 0, sizeof(strm));
+}
+
+ParallelCoordsPngWriter::~ParallelCoordsPngWriter()
+{
+	if(started)
+		deflateEnd(&strm);
+}
+
+bool ParallelCoordsPngWriter::writeChunk(char const *type,
+	QByteArray const& payload)
+{
+	QByteArray header;
+	{
+		QDataStream s(&header, QIODevice::WriteOnly);
+		s << static_cast<quint32>(payload.size());
+	}
+	header.append(type, 4);
+
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, reinterpret_cast<Bytef const*>(type), 4);
+	crc = crc32(crc, reinterpret_cast<Bytef const*>(payload.constData()),
+		payload.size());
+	QByteArray trailer;
+	{
+		QDataStream s(&trailer, QIODevice::WriteOnly);
+		s << static_cast<quint32>(crc);
+	}
+
+	return device->write(header) == header.size() &&
+		   device->write(payload) == payload.size() &&
+		   device->write(trailer) == trailer.size();
+}
+
+bool ParallelCoordsPngWriter::begin()
+{
+	if(device->write("\x89PNG\r\n\x1a\n", 8) != 8)
+		return false;
+
+	QByteArray ihdr;
+	{
+		QDataStream s(&ihdr, QIODevice::WriteOnly);
+		s << static_cast<quint32>(size.width())
+		  << static_cast<quint32>(size.height())
+		  << static_cast<quint8>(8)		// bit depth
+		  << static_cast<quint8>(2)		// truecolour
+		  << static_cast<quint8>(0)		// deflate
+		  << static_cast<quint8>(0)		// adaptive filtering
+		  << static_cast<quint8>(0);	// no interlace
+	}
+	if(!writeChunk("IHDR", ihdr))
+		return false;
+
+	// Plots are mostly flat background, the fast level does well
+	if(deflateInit(&strm, 3) != Z_OK)
+		return false;
+	started = true;
+	return true;
+}
+
+bool ParallelCoordsPngWriter::deflateData(uchar const *in, int len, int flush)
+{
+	uchar out[1 << 14];
+	strm.next_in = const_cast<Bytef*>(in);
+	strm.avail_in = len;
+
+	int ret;
+	do {
+		strm.next_out = out;
+		strm.avail_out = sizeof(out);
+		ret = deflate(&strm, flush);
+		if(ret == Z_STREAM_ERROR)
+			return false;
+		idat.append(reinterpret_cast<char*>(out), sizeof(out) - strm.avail_out);
+
+		if(idat.size() >= idatSize) {
+			if(!writeChunk("IDAT", idat))
+				return false;
+			idat.clear();
+		}
+	} while(flush == Z_FINISH ? ret != Z_STREAM_END : strm.avail_out == 0);
+
+	return true;
+}
+
+bool ParallelCoordsPngWriter::writeRows(QImage const& strip)
+{
+	if(!started || strip.width() != size.width())
+		return false;
+
+	const int width = size.width();
+	QVector<uchar> row(1 + 3 * width);
+	row[0] = 0;		// no filter
+	for(int y=0; y<strip.height() && rowsWritten<size.height(); y++) {
+		QRgb const *src = reinterpret_cast<QRgb const*>(strip.scanLine(y));
+		uchar *dst = row.data() + 1;
+		for(int x=0; x<width; x++) {
+			// tiles are drawn on an opaque background so premultiplied
+			// and straight colours are the same
+			*dst++ = qRed(src[x]);
+			*dst++ = qGreen(src[x]);
+			*dst++ = qBlue(src[x]);
+		}
+		if(!deflateData(row.constData(), row.count(), Z_NO_FLUSH))
+			return false;
+		rowsWritten++;
+	}
+	return true;
+}
+
+bool ParallelCoordsPngWriter::finish()
+{
+	if(!started || rowsWritten != size.height())
+		return false;
+
+	if(!deflateData(nullptr, 0, Z_FINISH))
+		return false;
+	if(!idat.isEmpty() && !writeChunk("IDAT", idat))
+		return false;
+	idat.clear();
+	return writeChunk("IEND", QByteArray());
+}
@@ -0,0 +1,33 @@
+#ifndef __PARALLELCOORDSPNGWRITER_H__
+#define __PARALLELCOORDSPNGWRITER_H__
+
+#include "ParallelCoordinates.h"
+#include <zlib.h>
+
+// Writes an RGB png a few rows at a time, so an image far larger
+// than memory can be produced from strips rendered one after another
+class ParallelCoordsPngWriter
+{
+public:
+	ParallelCoordsPngWriter(QIODevice *device, QSize size);
+	~ParallelCoordsPngWriter();
+
+	bool begin();
+	// Appends all rows of strip, which has to be as wide as the image
+	bool writeRows(QImage const& strip);
+	bool finish();
+
+private:
+	QIODevice *device;
+	QSize size;
+	int rowsWritten;
+	bool started;
+	z_stream strm;
+	QByteArray idat;
+	int idatSize;
+
+	bool deflateData(uchar const *in, int len, int flush);
+	bool writeChunk(char const *type, QByteArray const& payload);
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsPosterExport.h"
+#include "ParallelCoordsPngWriter.h"
+
+namespace {
+
+// Renders one strip and hands it back to the writer
+class stripJob : public QRunnable
+{
+public:
+	stripJob(ParallelCoordsRenderManager const *renderer_,
+		QRectF rect_, QSize size_, int sharers_, QImage **result_,
+		QMutex *lock_, QWaitCondition *done_)
+	: renderer(renderer_), rect(rect_), size(size_), sharers(sharers_),
+	  result(result_), lock(lock_), done(done_) {}
+
+	void run()
+	{
+		QImage *img = renderer->renderRegion(rect, size, nullptr, sharers);
+		QMutexLocker locker(lock);
+		*result = img;
+		done->wakeAll();
+	}
+
+private:
+	ParallelCoordsRenderManager const *renderer;
+	QRectF rect;
+	QSize size;
+	int sharers;		// strips in flight splitting the memory limit
+	QImage **result;
+	QMutex *lock;
+	QWaitCondition *done;
+};
+
+}
+
+ParallelCoordsPosterExport::ParallelCoordsPosterExport(QObject *parent,
+	QParallelCoordsData const *data,
+	QVector<axis_view_data> const& axis_data_,
+	QSize canvasSize_, qint64 memoryLimit_)
+: QObject(parent), canvasSize(canvasSize_), memoryLimit(memoryLimit_),
+  cancelled(false)
+{
+	maxStripHeight = 256;
+	maxStripsInFlight = qMax(2, QThread::idealThreadCount());
+
+	// A renderer of our own on a copy of the layout, the view can
+	// keep changing while the export runs
+	renderer = new ParallelCoordsRenderManager(
+		canvasSize,
+		qMakePair(1.0, 1.0),
+		canvasSize,
+		ParallelCoordsLayout(new QVector<axis_view_data>(axis_data_)),
+		data);
+	renderer->setMemoryLimit(memoryLimit);
+}
+
+ParallelCoordsPosterExport::~ParallelCoordsPosterExport()
+{
+	cancel();
+	future.waitForFinished();
+	delete renderer;
+}
+
+void ParallelCoordsPosterExport::start(QString fname, QSize imageSize)
+{
+	if(future.isRunning())
+		return;
+	cancelled = false;
+	future = QtConcurrent::run(this, &ParallelCoordsPosterExport::run,
+		fname, imageSize);
+}
+
+void ParallelCoordsPosterExport::cancel()
+{
+	cancelled = true;
+}
+
+bool ParallelCoordsPosterExport::run(QString fname, QSize imageSize)
+{
+	// Every strip in flight holds its coverage and its 32 bit copy, 5
+	// bytes a pixel. Strips get lower for wide posters so together
+	// they take at most half the memory limit, the rest is left for
+	// rendering them.
+	const qint64 rowBytes = qMax(imageSize.width(), 1) * static_cast<qint64>(1 + 4);
+	const int stripHeight = static_cast<int>(qBound(static_cast<qint64>(1),
+		memoryLimit / 2 / maxStripsInFlight / rowBytes,
+		static_cast<qint64>(maxStripHeight)));
+	const int stripCnt = (imageSize.height() + stripHeight - 1) / stripHeight;
+	const qreal canvasPerRow =
+		static_cast<qreal>(canvasSize.height()) / imageSize.height();
+
+	QFile f(fname);
+	bool ok = !imageSize.isEmpty() && !canvasSize.isEmpty() &&
+		f.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	ParallelCoordsPngWriter writer(&f, imageSize);
+	ok = ok && writer.begin();
+
+	// Strips render on their own pool, the renderer itself still
+	// spreads its work over the global one
+	QThreadPool pool;
+	pool.setMaxThreadCount(maxStripsInFlight);
+	QMutex lock;
+	QWaitCondition done;
+	QVector<QImage*> strips(stripCnt, nullptr);
+
+	int launched = 0;
+	for(int written=0; ok && written<stripCnt; written++) {
+		while(launched < stripCnt && launched - written < maxStripsInFlight) {
+			int top = launched * stripHeight;
+			int rows = qMin(stripHeight, imageSize.height() - top);
+			QRectF rect(0, top * canvasPerRow,
+				canvasSize.width(), rows * canvasPerRow);
+			pool.start(new stripJob(renderer, rect,
+				QSize(imageSize.width(), rows), maxStripsInFlight, &strips[launched],
+				&lock, &done));
+			launched++;
+		}
+
+		QImage *strip;
+		{
+			QMutexLocker locker(&lock);
+			while(strips[written] == nullptr)
+				done.wait(&lock);
+			strip = strips[written];
+			strips[written] = nullptr;
+		}
+
+		ok = writer.writeRows(*strip) && !cancelled;
+		delete strip;
+		emit progress(written+1, stripCnt);
+	}
+
+	pool.waitForDone();
+	foreach(QImage *strip, strips) {
+		delete strip;
+	}
+
+	ok = ok && writer.finish();
+	f.close();
+	if(!ok)
+		f.remove();
+
+	emit finished(ok);
+	return ok;
+}
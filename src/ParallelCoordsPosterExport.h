@@ -0,0 +1,44 @@
+#ifndef __PARALLELCOORDSPOSTEREXPORT_H__
+#define __PARALLELCOORDSPOSTEREXPORT_H__
+
+#include "ParallelCoordinates.h"
+#include "QParallelCoordsData.h"
+#include "ParallelCoordsViewPrivate.h"
+#include "ParallelCoordsRenderManager.h"
+#include <atomic>
+
+// Renders the whole canvas at an arbitrary resolution into a png.
+// The image is produced as horizontal strips on a few threads and
+// each strip is compressed into the file as soon as it is its turn,
+// so only the strips in flight are ever held in memory.
+class ParallelCoordsPosterExport : public QObject
+{
+	Q_OBJECT
+
+public:
+	ParallelCoordsPosterExport(QObject *parent,
+		QParallelCoordsData const *data,
+		QVector<axis_view_data> const& axis_data,
+		QSize canvasSize, qint64 memoryLimit);
+	~ParallelCoordsPosterExport();
+
+	void start(QString fname, QSize imageSize);
+	void cancel();
+
+signals:
+	void progress(int done, int total);
+	void finished(bool ok);
+
+private:
+	QSize canvasSize;
+	qint64 memoryLimit;
+	ParallelCoordsRenderManager *renderer;
+	QFuture<bool> future;
+	std::atomic<bool> cancelled;
+	int maxStripHeight;
+	int maxStripsInFlight;
+
+	bool run(QString fname, QSize imageSize);
+};
+
+#endif
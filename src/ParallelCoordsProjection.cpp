@@ -0,0 +1,136 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsProjection.h"
+
+// Vector kernels are compiled for their instruction set one function
+// at a time and only called when the cpu reports it, so the binary
+// still runs on plain x86-64
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PC_PROJECTION_DISPATCH
+#include <immintrin.h>
+#endif
+
+typedef void (*projectionKernel)(qreal const *in, qreal *out, int n,
+	qreal a, qreal b);
+
+// out = in * a + b, with the subtraction of min folded into b
+static void projectScalar(qreal const *in, qreal *out, int n,
+	qreal a, qreal b)
+{
+	for(int i=0; i<n; i++)
+		out[i] = in[i] * a + b;
+}
+
+#ifdef PC_PROJECTION_DISPATCH
+
+__attribute__((target("sse2")))
+static void projectSse2(qreal const *in, qreal *out, int n,
+	qreal a, qreal b)
+{
+	double const *src = reinterpret_cast<double const*>(in);
+	double *dst = reinterpret_cast<double*>(out);
+	const __m128d va = _mm_set1_pd(a);
+	const __m128d vb = _mm_set1_pd(b);
+	int i = 0;
+	for(; i+4 <= n; i += 4) {
+		__m128d x0 = _mm_loadu_pd(src+i);
+		__m128d x1 = _mm_loadu_pd(src+i+2);
+		_mm_storeu_pd(dst+i, _mm_add_pd(_mm_mul_pd(x0, va), vb));
+		_mm_storeu_pd(dst+i+2, _mm_add_pd(_mm_mul_pd(x1, va), vb));
+	}
+	for(; i<n; i++)
+		dst[i] = src[i] * a + b;
+}
+
+__attribute__((target("avx2")))
+static void projectAvx2(qreal const *in, qreal *out, int n,
+	qreal a, qreal b)
+{
+	double const *src = reinterpret_cast<double const*>(in);
+	double *dst = reinterpret_cast<double*>(out);
+	const __m256d va = _mm256_set1_pd(a);
+	const __m256d vb = _mm256_set1_pd(b);
+	int i = 0;
+	for(; i+8 <= n; i += 8) {
+		__m256d x0 = _mm256_loadu_pd(src+i);
+		__m256d x1 = _mm256_loadu_pd(src+i+4);
+		_mm256_storeu_pd(dst+i, _mm256_add_pd(_mm256_mul_pd(x0, va), vb));
+		_mm256_storeu_pd(dst+i+4, _mm256_add_pd(_mm256_mul_pd(x1, va), vb));
+	}
+	for(; i<n; i++)
+		dst[i] = src[i] * a + b;
+}
+
+__attribute__((target("avx512f")))
+static void projectAvx512(qreal const *in, qreal *out, int n,
+	qreal a, qreal b)
+{
+	double const *src = reinterpret_cast<double const*>(in);
+	double *dst = reinterpret_cast<double*>(out);
+	const __m512d va = _mm512_set1_pd(a);
+	const __m512d vb = _mm512_set1_pd(b);
+	int i = 0;
+	for(; i+8 <= n; i += 8) {
+		__m512d x = _mm512_loadu_pd(src+i);
+		_mm512_storeu_pd(dst+i, _mm512_add_pd(_mm512_mul_pd(x, va), vb));
+	}
+	// the tail goes through a mask instead of a scalar loop
+	if(i < n) {
+		__mmask8 m = static_cast<__mmask8>((1u << (n-i)) - 1);
+		__m512d x = _mm512_maskz_loadu_pd(m, src+i);
+		_mm512_mask_storeu_pd(dst+i, m,
+			_mm512_add_pd(_mm512_mul_pd(x, va), vb));
+	}
+}
+
+#endif
+
+namespace {
+
+struct kernelChoice {
+	projectionKernel kernel;
+	char const *name;
+};
+
+kernelChoice chooseKernel()
+{
+	kernelChoice choice = {projectScalar, "scalar"};
+#ifdef PC_PROJECTION_DISPATCH
+	// qreal is float on some embedded builds of Qt
+	if(sizeof(qreal) != sizeof(double))
+		return choice;
+
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) {
+		choice.kernel = projectAvx512;
+		choice.name = "avx512";
+	}
+	else if(__builtin_cpu_supports("avx2")) {
+		choice.kernel = projectAvx2;
+		choice.name = "avx2";
+	}
+	else if(__builtin_cpu_supports("sse2")) {
+		choice.kernel = projectSse2;
+		choice.name = "sse2";
+	}
+#endif
+	return choice;
+}
+
+kernelChoice const& kernel()
+{
+	static const kernelChoice choice = chooseKernel();
+	return choice;
+}
+
+}
+
+void ParallelCoordsProjection::project(qreal const *in, qreal *out, int n,
+	qreal min, qreal scale, qreal offset)
+{
+	kernel().kernel(in, out, n, scale, offset - min * scale);
+}
+
+char const* ParallelCoordsProjection::kernelName()
+{
+	return kernel().name;
+}
@@ -0,0 +1,18 @@
+#ifndef __PARALLELCOORDSPROJECTION_H__
+#define __PARALLELCOORDSPROJECTION_H__
+
+#include "ParallelCoordinates.h"
+
+// Maps a block of column values onto an axis,
+// out[i] = (in[i] - min) * scale + offset. The widest vector unit the
+// cpu has is picked the first time a block is projected.
+class ParallelCoordsProjection
+{
+public:
+	static void project(qreal const *in, qreal *out, int n,
+		qreal min, qreal scale, qreal offset);
+	// sse2, avx2, avx512 or scalar
+	static char const* kernelName();
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef __PARALLELCOORDSPUBLISHED_H__
+#define __PARALLELCOORDSPUBLISHED_H__
+
+#include "ParallelCoordinates.h"
+
+// The current version of some state read by other threads. The owner
+// builds a new immutable T and swaps it in, readers take a reference
+// to whatever is current and keep using it for as long as they like.
+// The lock only guards the pointer swap, nobody ever waits on a
+// reader.
+template <class T>
+class ParallelCoordsPublished
+{
+public:
+	typedef QSharedPointer<T const> pointer;
+
+	ParallelCoordsPublished() : ver(0) {}
+
+	pointer load() const
+	{
+		QMutexLocker locker(&lock);
+		return current;
+	}
+
+	// Returns the version given to next
+	quint64 publish(pointer next)
+	{
+		QMutexLocker locker(&lock);
+		current = next;
+		return ++ver;
+	}
+
+	quint64 version() const
+	{
+		QMutexLocker locker(&lock);
+		return ver;
+	}
+
+private:
+	mutable QMutex lock;
+	pointer current;
+	quint64 ver;
+};
+
+#endif
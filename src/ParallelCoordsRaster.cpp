@@ -0,0 +1,204 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsRaster.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+QVector<QRgb> ParallelCoordsRaster::colorTable()
+{
+	// white background, every line black however many overlap
+	static QVector<QRgb> table;
+	static QMutex tableLock;
+	QMutexLocker locker(&tableLock);
+	if(table.isEmpty()) {
+		table.push_back(qRgb(255, 255, 255));
+		for(int i=1; i<256; i++)
+			table.push_back(qRgb(0, 0, 0));
+	}
+	return table;
+}
+
+QImage* ParallelCoordsRaster::newCoverageImage(QSize size)
+{
+	QImage *img = new QImage(size, QImage::Format_Indexed8);
+	img->setColorTable(colorTable());
+	img->fill(0);
+	return img;
+}
+
+QByteArray ParallelCoordsRaster::pack(QImage const& img)
+{
+	const int width = img.width();
+	QByteArray out;
+	for(int y=0; y<img.height(); y++) {
+		uchar const *row = img.constScanLine(y);
+		int i = 0;
+		while(i < width) {
+			int run = 1;
+			while(i+run < width && run < 128 && row[i+run] == row[i])
+				run++;
+			if(run >= 2) {
+				out.append(static_cast<char>(257 - run));
+				out.append(static_cast<char>(row[i]));
+				i += run;
+				continue;
+			}
+
+			// literals up to the start of the next run
+			int start = i++;
+			while(i < width && i-start < 128 && 
+				  !(i+1 < width && row[i] == row[i+1]))
+				i++;
+			out.append(static_cast<char>(i - start - 1));
+			out.append(reinterpret_cast<char const*>(row + start), i - start);
+		}
+	}
+	return out;
+}
+
+QImage* ParallelCoordsRaster::unpack(QByteArray const& bytes, QSize size)
+{
+	QImage *img = newCoverageImage(size);
+	uchar const *p = reinterpret_cast<uchar const*>(bytes.constData());
+	uchar const *end = p + bytes.size();
+	for(int y=0; y<size.height() && p<end; y++) {
+		uchar *row = img->scanLine(y);
+		int x = 0;
+		while(x < size.width() && p < end) {
+			int h = *p++;
+			if(h < 128) {
+				int n = qMin(h + 1, static_cast<int>(end - p));
+				n = qMin(n, size.width() - x);
+				memcpy(row + x, p, n);
+				p += h + 1;
+				x += n;
+			}
+			else {
+				int n = qMin(257 - h, size.width() - x);
+				if(p < end)
+					memset(row + x, *p++, n);
+				x += n;
+			}
+		}
+	}
+	return img;
+}
+
+namespace {
+
+// Pixel ends of a line as drawLines rounds them. Lines come clipped to
+// the band, rounding can still put an end one pixel past its edge.
+struct pixelEnds {
+	int x0, y0, x1, y1;
+};
+
+inline pixelEnds roundEnds(QLineF const& line, QRect const& band,
+	qreal left, qreal top, qreal sx, qreal sy)
+{
+	pixelEnds e = {
+		qBound(band.left(), static_cast<int>(std::floor(
+			(line.x1() - left) * sx)), band.right()),
+		qBound(band.top(), static_cast<int>(std::floor(
+			(line.y1() - top) * sy)), band.bottom()),
+		qBound(band.left(), static_cast<int>(std::floor(
+			(line.x2() - left) * sx)), band.right()),
+		qBound(band.top(), static_cast<int>(std::floor(
+			(line.y2() - top) * sy)), band.bottom())};
+	return e;
+}
+
+// Bresenham, every pixel of a line is counted once, add times
+inline void plot(uchar *bits, int bytesPerLine, pixelEnds e, uint add)
+{
+	int x0 = e.x0, y0 = e.y0;
+	const int x1 = e.x1, y1 = e.y1;
+	const int dx = qAbs(x1 - x0), stepX = x0 < x1 ? 1 : -1;
+	const int dy = -qAbs(y1 - y0), stepY = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+	for(;;) {
+		uchar &p = bits[y0 * bytesPerLine + x0];
+		p = static_cast<uchar>(qMin(p + add, 255u));
+		if(x0 == x1 && y0 == y1)
+			break;
+		const int e2 = 2 * err;
+		if(e2 >= dy) {
+			err += dy;
+			x0 += stepX;
+		}
+		if(e2 <= dx) {
+			err += dx;
+			y0 += stepY;
+		}
+	}
+}
+
+bool endsBefore(ParallelCoordsRaster::pixelSegment const& a,
+	ParallelCoordsRaster::pixelSegment const& b)
+{
+	return a.ends < b.ends;
+}
+
+}
+
+void ParallelCoordsRaster::drawLines(uchar *bits, int bytesPerLine,
+	QSize imgSize, QRect band, QRectF visible_rect,
+	QLineF const *lines, int n, quint32 const *weights, int const *rows)
+{
+	const qreal sx = imgSize.width() / visible_rect.width();
+	const qreal sy = imgSize.height() / visible_rect.height();
+	const qreal left = visible_rect.left();
+	const qreal top = visible_rect.top();
+
+	for(int k=0; k<n; k++) {
+		const uint add = weights ? qMin(weights[rows[k]], 255u) : 1;
+		plot(bits, bytesPerLine,
+			roundEnds(lines[k], band, left, top, sx, sy), add);
+	}
+}
+
+int ParallelCoordsRaster::collapseLines(QSize imgSize, QRect band,
+	QRectF visible_rect, QLineF const *lines, int n,
+	quint32 const *weights, int const *rows, pixelSegment *out)
+{
+	Q_ASSERT(imgSize.width() <= 0xffff && imgSize.height() <= 0xffff);
+	const qreal sx = imgSize.width() / visible_rect.width();
+	const qreal sy = imgSize.height() / visible_rect.height();
+	const qreal left = visible_rect.left();
+	const qreal top = visible_rect.top();
+
+	for(int k=0; k<n; k++) {
+		const pixelEnds e = roundEnds(lines[k], band, left, top, sx, sy);
+		out[k].ends = static_cast<quint64>(e.x0) << 48 |
+			static_cast<quint64>(e.y0) << 32 |
+			static_cast<quint64>(e.x1) << 16 |
+			static_cast<quint64>(e.y1);
+		out[k].count = weights ? qMin(weights[rows[k]], 255u) : 1;
+	}
+
+	// Equal ends end up next to each other, counts saturate at the
+	// 255 a pixel can hold anyway
+	std::sort(out, out + n, endsBefore);
+	int cnt = 0;
+	for(int k=0; k<n; k++) {
+		if(cnt > 0 && out[cnt-1].ends == out[k].ends) {
+			out[cnt-1].count = qMin(out[cnt-1].count + out[k].count, 255u);
+			continue;
+		}
+		out[cnt++] = out[k];
+	}
+	return cnt;
+}
+
+void ParallelCoordsRaster::drawSegments(uchar *bits, int bytesPerLine,
+	pixelSegment const *segments, int n)
+{
+	for(int k=0; k<n; k++) {
+		const quint64 ends = segments[k].ends;
+		pixelEnds e = {
+			static_cast<int>(ends >> 48),
+			static_cast<int>((ends >> 32) & 0xffff),
+			static_cast<int>((ends >> 16) & 0xffff),
+			static_cast<int>(ends & 0xffff)};
+		plot(bits, bytesPerLine, e, qMin(segments[k].count, 255u));
+	}
+}
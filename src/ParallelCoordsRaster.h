@@ -0,0 +1,49 @@
+#ifndef __PARALLELCOORDSRASTER_H__
+#define __PARALLELCOORDSRASTER_H__
+
+#include "ParallelCoordinates.h"
+
+// Tiles are 8 bit images counting the lines that cross each pixel,
+// up to 255. The colour table turns counts into colours, so tiles are
+// only expanded to 32 bits when they are put on screen.
+class ParallelCoordsRaster
+{
+public:
+	// A cleared Format_Indexed8 image with the colour table set
+	static QImage* newCoverageImage(QSize size);
+	static QVector<QRgb> colorTable();
+
+	// Run length coding of coverage images, a header byte h below 128
+	// is followed by h+1 literal bytes, above it by one byte repeated
+	// 257-h times
+	static QByteArray pack(QImage const& img);
+	static QImage* unpack(QByteArray const& bytes, QSize size);
+
+	// Draws one pixel wide lines given in the canvas coordinates of
+	// visible_rect, which spans the whole image. Only pixels inside
+	// band are written so several threads can share one image.
+	// Unless weights is nullptr line k counts weights[rows[k]] times.
+	static void drawLines(uchar *bits, int bytesPerLine, QSize imgSize,
+		QRect band, QRectF visible_rect, QLineF const *lines, int n,
+		quint32 const *weights = nullptr, int const *rows = nullptr);
+
+	// A line reduced to the pixels of its ends, 16 bits per coordinate,
+	// and how many lines share them
+	struct pixelSegment {
+		quint64 ends;
+		quint32 count;
+	};
+	// Zoomed out, most lines between two axes land on the same pair of
+	// pixels. This rounds the ends as drawLines does and merges the
+	// lines sharing them, drawing what is left with drawSegments gives
+	// the same image. out needs room for n segments, the number written
+	// is returned. Images wider or taller than 65535 pixels are not
+	// supported.
+	static int collapseLines(QSize imgSize, QRect band, QRectF visible_rect,
+		QLineF const *lines, int n, quint32 const *weights, int const *rows,
+		pixelSegment *out);
+	static void drawSegments(uchar *bits, int bytesPerLine,
+		pixelSegment const *segments, int n);
+};
+
+#endif
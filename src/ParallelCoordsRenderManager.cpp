@@ -1,85 +1,193 @@
 
 #include "ParallelCoordinates.h"
 #include "ParallelCoordsRenderManager.h"
+#include "ParallelCoordsRenderService.h"
+#include "ParallelCoordsProjection.h"
+#include "ParallelCoordsClipper.h"
+#include "ParallelCoordsRaster.h"
 #include <functional>
+#include <algorithm>
+#include <vector>
 
-static void renderPolylines(QImage *img, 
-	QRectF visible_rect, 
-	QVector<QPolygonF> const *polyLineSet);
+namespace {
 
-static QVector<QLineF> 
-selectVisibleSegments(QPolygonF polyLine, QRectF visible_rect);
+// A block of one column to project, blocks are spread over the cores.
+// Without in the rows are projected straight out of the snapshot.
+struct projectionJob {
+	qreal const *in;
+	qreal *out;
+	int n;
+	qreal min;
+	qreal scale;
+	qreal offset;
+	ParallelCoordsDataSnapshot const *source;
+	int axis;
+	int firstRow;
+};
 
-QVector<QLineF> selectVisibleSegments(QPolygonF polyLine, QRectF visible_rect)
+void runProjection(projectionJob const& job)
 {
-	QVector<QLineF> segments;
+	if(job.in)
+		ParallelCoordsProjection::project(job.in, job.out, job.n,
+			job.min, job.scale, job.offset);
+	else
+		job.source->project(job.axis, job.firstRow, job.n,
+			job.min, job.scale, job.offset, job.out);
+}
+
+// The segments between one pair of axes, clipped into their own
+// stretch of the output buffer. With collapsed set the lines are then
+// merged by their pixel ends into it, cnt counts what is left there.
+struct clipJob {
+	qreal xl;
+	qreal xr;
+	qreal const *yl;
+	qreal const *yr;
+	quint64 const *validLeft;
+	quint64 const *validRight;
+	int n;
+	QRectF rect;
+	QLineF *out;
+	int *rows;		// only for weighted rows
+	quint32 const *weights;
+	ParallelCoordsRaster::pixelSegment *collapsed;
+	QSize imgSize;
+	QRect band;
+	QRectF visible_rect;
+	int cnt;
+};
 
-	// Build individual segments
-	// Filter the segments
-	// Return lines	
-	for(auto it=polyLine.begin()+1; it != polyLine.end(); it++) {
-		QPointF pt1(*(it-1));
-		QPointF pt2(*it);
-		QLineF l(*(it-1), *it);
-		QRectF r(qMin(pt1.x(), pt2.x()),
-			     qMin(pt1.y(), pt2.y()),
-			     qMax(pt1.x(), pt2.x()),
-			     qMax(pt1.y(), pt2.y()));
-		if(visible_rect.intersects(r))
-			segments.push_back(l);
+void runClip(clipJob &job)
+{
+	job.cnt = ParallelCoordsClipper::clipPair(job.xl, job.xr,
+		job.yl, job.yr, job.n, job.rect, job.out, job.rows,
+		job.validLeft, job.validRight);
+	if(job.collapsed)
+		job.cnt = ParallelCoordsRaster::collapseLines(job.imgSize, job.band,
+			job.visible_rect, job.out, job.cnt, job.weights, job.rows,
+			job.collapsed);
+}
+
+// Clears the bits of the rows of a chunk that are not in mask. Chunks
+// start at a multiple of 64, so at a word of the mask.
+void maskWords(rowMask const *mask, int firstRow, int words, quint64 *bits)
+{
+	const int firstWord = firstRow >> 6;
+	for(int w=0; w<words; w++) {
+		const int word = firstWord + w;
+		bits[w] &= word < mask->words.count() ? mask->words[word] : 0;
 	}
+}
+
+// Sets the bits of the values of a column that are not NaN, which is
+// how column files and shared segments mark missing ones
+void validWords(qreal const *values, int count, quint64 *bits)
+{
+	memset(bits, 0, (count + 63) / 64 * sizeof(quint64));
+	for(int i=0; i<count; i++) {
+		if(!qIsNaN(values[i]))
+			bits[i >> 6] |= static_cast<quint64>(1) << (i & 63);
+	}
+}
+
+// One band of a coverage image and the chunk to draw into it
+struct rasterJob {
+	uchar *bits;
+	int bytesPerLine;
+	QSize imgSize;
+	QRect band;
+	QRectF visible_rect;
+	renderChunk const *chunk;
+	QVector<renderData> const *ppd;
+	int threadingThreshold;
+	int collapseThreshold;
+	bandScratch *scratch;
+};
 
-	return segments;
 }
 
-// Render on to img, the specified region on the canvas described
-void renderPolylines(QImage *img, QRectF visible_rect, 
-	QVector<QPolygonF> const *polyLineSet)
+static void renderPolylines(rasterJob job);
+
+// Render on to the band of the image, the specified region on the
+// canvas described
+void renderPolylines(rasterJob job)
 {
-	// Filter lines that have both ends out of view
-	QVector<QLineF> segments;
+	// The part of the canvas that falls into the band
+	QRectF const& visible_rect = job.visible_rect;
+	const qreal sx = job.imgSize.width() / visible_rect.width();
+	const qreal sy = job.imgSize.height() / visible_rect.height();
+	QRectF clip(visible_rect.left() + job.band.left() / sx,
+				visible_rect.top() + job.band.top() / sy,
+				job.band.width() / sx,
+				job.band.height() / sy);
 
-	using namespace std::placeholders;
-	auto result = QtConcurrent::mapped(*polyLineSet, 
-		std::bind(selectVisibleSegments, _1, visible_rect));
-	result.waitForFinished();
+	// Segments are clipped to the band one pair of axes at a time
+	// straight from the projected columns. Every pair owns rowCnt
+	// lines of the buffer so pairs can be clipped in parallel.
+	bandScratch *scratch = job.scratch;
+	std::vector<QLineF> &segments = scratch->segments;
+	std::vector<clipJob> jobs;
 
-	for(auto it=result.constBegin(); it != result.constEnd(); it++) {
-		for(auto i=(*it).begin(); i != (*it).end(); i++)
-			segments.push_back(*i);
+	renderChunk const *chunk = job.chunk;
+	const int rowCnt = chunk->rowCnt;
+	for(int j=0; j+1<chunk->axisCnt; j++) {
+		const qreal xl = (*job.ppd)[j].axis_x;
+		const qreal xr = (*job.ppd)[j+1].axis_x;
+		if(xr < clip.left() || xl > clip.right())
+			continue;
+		const size_t words = (rowCnt + 63) / 64;
+		clipJob c = {xl, xr, chunk->ys + j * rowCnt,
+			chunk->ys + (j+1) * rowCnt, chunk->drawn + j * words,
+			chunk->drawn + (j+1) * words, rowCnt, clip, nullptr, nullptr,
+			chunk->weights, nullptr, job.imgSize, job.band, visible_rect, 0};
+		jobs.push_back(c);
 	}
 
-	// setup image, painter, transforms and clipping region
-	// draw to bitmap
-	/*
-	* ====================   Important note    =====================
-	* Don't change order of scale, translate and setClipRect
-	* painter applies the latest function called first
-	* So we are clipping first
-	* then we are translating 
-	* and finally scaling
-	* Try working out a few numeirc examples in minds before attempting 
-	* to change the order of the numbers
-	*/
+	// Weighted rows also need to know which row each line came from.
+	// With many more rows than the band has pixel rows, lines are
+	// merged by their pixel ends so each pair of ends is drawn once,
+	// whatever the number of rows. Pairs are clipped and drawn a wave
+	// at a time, so the buffers hold the lines of a wave, not of all
+	// the axes.
+	const size_t wave = qMax(1, QThread::idealThreadCount());
+	const size_t needed = qMin(jobs.size(), wave) * rowCnt;
+	const bool collapse = rowCnt >= job.collapseThreshold * job.band.height() &&
+		job.imgSize.width() <= 0xffff && job.imgSize.height() <= 0xffff;
+	if(segments.size() < needed)
+		segments.resize(needed);
+	if(chunk->weights && scratch->segmentRows.size() < needed)
+		scratch->segmentRows.resize(needed);
+	if(collapse && scratch->pixelSegments.size() < needed)
+		scratch->pixelSegments.resize(needed);
 
-	QSizeF viewportSize = img->size();
-	img->fill(QColor(255,255,255));
-	QPainter painter;
-	{
-		bool stat = painter.begin(img);
-		Q_ASSERT(stat);
-	}
-	painter.scale(viewportSize.width()/visible_rect.width(), 
-		viewportSize.height()/visible_rect.height());
-	painter.translate(visible_rect.topLeft() * -1);
-	painter.setClipRect(visible_rect);
+	for(size_t first=0; first<jobs.size(); first+=wave) {
+		const size_t last = qMin(jobs.size(), first + wave);
+		for(size_t k=first; k<last; k++) {
+			const size_t offset = (k - first) * rowCnt;
+			jobs[k].out = segments.data() + offset;
+			if(chunk->weights)
+				jobs[k].rows = scratch->segmentRows.data() + offset;
+			if(collapse)
+				jobs[k].collapsed = scratch->pixelSegments.data() + offset;
+		}
 
-	//draw all the axis lines
-	QPen linePen;
-	linePen.setWidthF(0);
-	painter.setPen(linePen);
-	painter.drawLines(segments);
-	painter.end();
+		if(last - first > 1 && 
+		   static_cast<qint64>(last - first) * rowCnt >= job.threadingThreshold)
+			QtConcurrent::blockingMap(jobs.begin() + first,
+				jobs.begin() + last, runClip);
+		else
+			std::for_each(jobs.begin() + first, jobs.begin() + last, runClip);
+
+		for(size_t k=first; k<last; k++) {
+			if(jobs[k].collapsed)
+				ParallelCoordsRaster::drawSegments(job.bits, job.bytesPerLine,
+					jobs[k].collapsed, jobs[k].cnt);
+			else
+				ParallelCoordsRaster::drawLines(job.bits, job.bytesPerLine,
+					job.imgSize, job.band, visible_rect, jobs[k].out, jobs[k].cnt,
+					chunk->weights, jobs[k].rows);
+		}
+	}
 }
 
 uint qHash(QRect rect)
@@ -90,17 +198,60 @@ uint qHash(QRect rect)
 
 ParallelCoordsRenderManager::ParallelCoordsRenderManager(
 	QSize canvasSize_,
-	QPair<qreal, qreal> scaleFactors_,
+	QPair<qreal, qreal> density_,
 	QSize viewportSize_,
-	QList<axis_view_data> const *axis_data_,
+	ParallelCoordsLayout layout_,
 	QParallelCoordsData const *data_)
-: data(data_), axis_data(axis_data_)
+: data(data_)
 {
+	layout.publish(layout_);
 	canvasSize = canvasSize_;
-	scaleFactors = scaleFactors_;
+	density = density_;
 	viewportSize = viewportSize_;
+	tileSize = 256;
 	threadingThreshold = 15000;
+	collapseThreshold = 4;
+	tileFormat = 3;
+	projectionBlockRows = 32 * 1024;
 	axisPenWidth = 2;
+	maxPickedRows = 16;
+	memoryLimit = 256 * 1024 * 1024;
+	rawTileLimit = 256;
+	packedLimit = 64 * 1024 * 1024;
+	packedBytes = 0;
+	pickLimit = 256 * 1024 * 1024;
+	pickBytes = 0;
+	cacheGeneration = 0;
+	diskCache = ParallelCoordsDiskCache::instance();
+	service = nullptr;
+}
+
+QParallelCoordsData const* ParallelCoordsRenderManager::getData() const
+{
+	return data;
+}
+
+void ParallelCoordsRenderManager::setLayout(ParallelCoordsLayout layout_)
+{
+	layout.publish(layout_);
+}
+
+void ParallelCoordsRenderManager::setRowMask(ParallelCoordsRowMask mask)
+{
+	visibleRows.publish(mask);
+}
+
+ParallelCoordsRenderManager::renderState 
+ParallelCoordsRenderManager::currentState() const
+{
+	renderState state = {layout.load(), data->snapshot(), visibleRows.load()};
+	return state;
+}
+
+void ParallelCoordsRenderManager::setService(
+	ParallelCoordsRenderService *service_)
+{
+	service = service_;
 }
 
 void ParallelCoordsRenderManager::flushCache()
@@ -109,99 +260,197 @@ void ParallelCoordsRenderManager::flushCache()
 		delete i;
 	}
 	imgCache.clear();
+	packedCache.clear();
+	packedBytes = 0;
+	recentTiles.clear();
+	packingTiles.clear();
+	cacheGeneration++;
+	diskTiles.clear();
+	pickCache.clear();
+	recentStrips.clear();
+	pickBytes = 0;
 }
 
 void ParallelCoordsRenderManager::viewportSizeChange(QSize viewportSize_)
 {
+	// tiles do not depend on the viewport, only what is assembled
 	viewportSize = viewportSize_;
-	imgCache.clear();
 }
 
 void ParallelCoordsRenderManager::canvasSizeChange(QSize canvasSize_)
 {
 	canvasSize = canvasSize_;
-	imgCache.clear();
+	flushCache();
 }
 
-void ParallelCoordsRenderManager::scaleFactorsChange(
-	QPair<qreal, qreal> scaleFactors_)
+void ParallelCoordsRenderManager::densityChange(QPair<qreal, qreal> density_)
 {
-	scaleFactors = scaleFactors_;
-	imgCache.clear();
+	density = density_;
+	flushCache();
 }
 
 void ParallelCoordsRenderManager::axisDataChange()
 {
-	imgCache.clear();
+	flushCache();
 }
 
-void ParallelCoordsRenderManager::getTile(QRect rect)
+void ParallelCoordsRenderManager::rowMaskChange()
 {
-	// One tile is what can be displayed in the viewport
-	// at current scale factor levels
-	// Check if aligned rectangle
-	// if aligned rectangle fetch and return
-	// else split into aligned rectangles
-	// fetch and assemble
-	// Note cache only holds images of the same scale level
-	// so any request will be satisfied by atmost four rectangles
-	int xVisiblePixels = canvasSize.width() * scaleFactors.first;
-	int yVisiblePixels = canvasSize.height() * scaleFactors.second;
+	flushCache();
+}
 
-	QList<QRect> candidates;
-	if(rect.top() % yVisiblePixels != 0) {
-		QRect rect1(rect.left(),
-					(rect.top() / yVisiblePixels) * yVisiblePixels,
-					xVisiblePixels,
-					yVisiblePixels);
-		QRect rect2 = rect1;
-		rect2.moveTop(rect1.top() + rect1.height());
-		candidates.push_back(rect1);
-		candidates.push_back(rect2);
-	}
-	else {
-		candidates.push_back(rect);
-	}
-
-	for(int i=candidates.count(); i>0; i--) {
-		QRect r = candidates.front();
-		candidates.pop_front();
-		if(r.left() % xVisiblePixels != 0) {
-			QRect rect1((r.left() / xVisiblePixels) * xVisiblePixels,
-						r.top(),
-						xVisiblePixels,
-						yVisiblePixels);
-			QRect rect2 = rect1;
-			rect2.moveLeft(rect1.left() + rect1.width());
-			candidates.push_back(rect1);
-			candidates.push_back(rect2);
+QByteArray ParallelCoordsRenderManager::tileKey(QRect r,
+	renderState const& state) const
+{
+	// Everything that changes the pixels of a tile
+	QByteArray view;
+	{
+		QDataStream strm(&view, QIODevice::WriteOnly);
+		strm << tileFormat;
+		strm << canvasSize << density.first << density.second
+			 << tileSize << r << axisPenWidth;
+		foreach(axis_view_data const& a, *state.axes) {
+			strm << a.index << a.x;
 		}
-		else {
-			candidates.push_back(r);
+	}
+
+	QCryptographicHash h(QCryptographicHash::Sha1);
+	h.addData(state.data->contentHash());
+	h.addData(view);
+	if(state.data->selection())
+		h.addData(state.data->selection()->hash);
+	if(state.mask)
+		h.addData(state.mask->hash);
+	return h.result();
+}
+
+void ParallelCoordsRenderManager::pick(QPointF pt, qreal tolerance)
+{
+	// Picks are answered from the index of the strip under the point,
+	// nothing is picked until a tile of it has been rendered. An index
+	// evicted to stay within pickLimit is built again by rendering the
+	// tile under the point once more.
+	QVector<int> rows;
+	const QPointF pixel(pt.x() * density.first, pt.y() * density.second);
+	const QRect tile(qFloor(pixel.x() / tileSize) * tileSize,
+		qFloor(pixel.y() / tileSize) * tileSize, tileSize, tileSize);
+	const QRect strip = pickStrip(tile);
+	if(!pickCache.contains(strip) &&
+	   (imgCache.contains(tile) || packedCache.contains(tile))) {
+		const renderState state = currentState();
+		if(!state.data->isOutOfCore() && fitsPickLimit(tile, state)) {
+			QList<QRect> tiles;
+			tiles.push_back(tile);
+			QVector<QImage*> fresh = renderTiles(tiles, state);
+			delete fresh.first();
 		}
 	}
+	if(pickCache.contains(strip)) {
+		recentStrips.removeOne(strip);
+		recentStrips.push_back(strip);
+		rows = pickCache.value(strip)->pick(pt, tolerance, maxPickedRows);
+	}
+	emit rowsPicked(pt, rows);
+}
 
+QRectF ParallelCoordsRenderManager::tileRect(QRect tile) const
+{
+	return QRectF(tile.left() / density.first, tile.top() / density.second,
+		tile.width() / density.first, tile.height() / density.second);
+}
+
+void ParallelCoordsRenderManager::getTile(QRect rect)
+{
+	// img is ready to send back
+	emit tileGenerated(rect, assembleTile(rect));
+	packIdleTiles();
+
+	lastRequest = rect;
+	if(!diskTiles.isEmpty())
+		QMetaObject::invokeMethod(this, "verifyDiskTiles", Qt::QueuedConnection);
+}
+
+QImage* ParallelCoordsRenderManager::assembleTile(QRect rect)
+{
+	// Tiles are tileSize device pixels square, on a grid that starts
+	// at the canvas origin and is laid at the current density. A
+	// request of any size is assembled from the tiles it overlaps, so
+	// a resize only needs the tiles along the new edges. Tile rects
+	// are kept in device pixels, as they are on the grid.
+	const renderState state = currentState();
+	const QPoint origin(qFloor(rect.left() * density.first),
+						qFloor(rect.top() * density.second));
+	const QRect pixels(origin, viewportSize);
+
+	QList<QRect> candidates;
+	for(int row=pixels.top() / tileSize; row<=pixels.bottom() / tileSize; row++) {
+		for(int col=pixels.left() / tileSize; col<=pixels.right() / tileSize; col++)
+			candidates.push_back(QRect(col * tileSize, row * tileSize,
+				tileSize, tileSize));
+	}
+
+	// Packed tiles are expanded again, that is far cheaper
+	// than rendering them
 	QList<QRect> missing;
 	foreach(QRect r, candidates) {
+		if(imgCache.find(r) == imgCache.end() && packedCache.contains(r)) {
+			packedTile p = packedCache.take(r);
+			packedBytes -= p.bytes.size();
+			imgCache.insert(r, ParallelCoordsRaster::unpack(p.bytes, p.size));
+		}
 		if(imgCache.find(r) == imgCache.end())
 			missing.push_back(r);
+		touchTile(r);
 	}
 
-	// If tiles are missing contruct them using the render function
-	// add the new tiles to the cache
-	// Construct image from tiles
-	// return image
-	if(!missing.isEmpty()) {
-		foreach(QRect r, missing) {
-			QVector<renderData> *ppd;
-			QVector<QPolygonF> *polyLineSet;
-			filterData(r, &ppd, &polyLineSet);
-			auto i = renderImage(polyLineSet, ppd, r, viewportSize);
-			imgCache.insert(r, i);
-
-			delete ppd;
-			delete polyLineSet;
+	// Tiles seen in an earlier session come back from the disk cache,
+	// only what is not there is rendered
+	QList<QRect> toRender;
+	QList<QByteArray> toRenderKeys;
+	foreach(QRect r, missing) {
+		QByteArray key = tileKey(r, state);
+
+		// Another view at the same density may have it already
+		ParallelCoordsRenderService::sharedTile shared;
+		if(service && service->findTile(key, &shared)) {
+			imgCache.insert(r, new QImage(shared.tile));
+			if(shared.pickIndex && !pickCache.contains(pickStrip(r)))
+				cachePickIndex(pickStrip(r), shared.pickIndex);
+			continue;
+		}
+
+		QImage *i = diskCache->load(key);
+		if(i == nullptr || i->size() != QSize(tileSize, tileSize) ||
+		   i->format() != QImage::Format_Indexed8) {
+			delete i;
+			toRender.push_back(r);
+			toRenderKeys.push_back(key);
+			continue;
 		}
+		if(!state.data->isOutOfCore()) {
+			// out of core tiles have no pick index to build,
+			// rendering them again would defeat the cache
+			diskTiles.push_back(r);
+		}
+		imgCache.insert(r, i);
+	}
+
+	// The tiles still missing are rendered side by side
+	QVector<QImage*> rendered = renderTiles(toRender, state);
+	for(int k=0; k<toRender.count(); k++) {
+		QRect r = toRender[k];
+		QImage *i = rendered[k];
+		// partially loaded data is never seen again
+		if(!state.data->isLoading()) {
+			diskCache->store(toRenderKeys[k], *i);
+			if(service) {
+				ParallelCoordsRenderService::sharedTile shared;
+				shared.tile = *i;
+				shared.pickIndex = pickCache.value(pickStrip(r));
+				service->shareTile(toRenderKeys[k], shared);
+			}
+		}
+		imgCache.insert(r, i);
 	}
 
 	QImage *img = new QImage(viewportSize, QImage::Format_ARGB32_Premultiplied);
@@ -211,48 +460,329 @@ void ParallelCoordsRenderManager::getTile(QRect rect)
 		bool stat = painter.begin(img);
 		Q_ASSERT(stat);
 	}
-	int xOffset, yOffset;
-	xOffset = yOffset = 0;
 	foreach(QRect r, candidates) {
-		QRect cr = r & rect;
-		QImage const * const i = imgCache[r];
-		// translate from rect to image coordinates
-		// rectangle uses canvas coords
-		// image uses viewport coords
-		qreal xScale = i->width() / static_cast<double>(r.width());
-		qreal yScale = i->height() / static_cast<double>(r.height());
-		QTransform t;
-		t.scale(xScale, yScale);
-		t.translate(r.left() * -1.0, r.top() * -1.0);
-		QRect rectToCopy(t.mapRect(cr));
-		QImage ii = i->copy(rectToCopy);
-		painter.drawImage(xOffset, yOffset, ii);
-		
-		xOffset += rectToCopy.width();
-		if(xOffset >= img->width()) {
-			xOffset = 0;
-			yOffset += rectToCopy.height();
-		}
+		painter.drawImage(r.topLeft() - origin, *imgCache[r]);
 	}
 	painter.end();
 
-	// img is ready to send back
-	emit tileGenerated(rect, img);
+	// Tiles only hold the lines, axes keep a constant width on screen
+	// and go on top of the assembled image
+	QRectF visible_rect = tileRect(pixels);
+	QVector<renderData> *ppd = relevantAxes(visible_rect, state);
+	renderAxes(img, ppd, visible_rect);
+	delete ppd;
+	return img;
 }
 
-void ParallelCoordsRenderManager::filterData(
-	QRectF visible_rect,
-	QVector<renderData> **ppd_ptr,
-	QVector<QPolygonF> **polyLineSet_ptr)
+void ParallelCoordsRenderManager::verifyDiskTiles()
+{
+	// Tiles shown from the disk cache are rendered again once they are
+	// on screen. That builds their pick index and catches stale files,
+	// the view is only refreshed when a tile turns out different.
+	const renderState state = currentState();
+	QList<QRect> tiles;
+	while(!diskTiles.isEmpty()) {
+		QRect r = diskTiles.takeFirst();
+		if(imgCache.contains(r) && !tiles.contains(r))
+			tiles.push_back(r);
+	}
+
+	bool changed = false;
+	QVector<QImage*> fresh = renderTiles(tiles, state);
+	for(int k=0; k<tiles.count(); k++) {
+		QRect r = tiles[k];
+		QImage *old = imgCache.take(r);
+		packingTiles.remove(r);
+		if(*fresh[k] != *old) {
+			changed = true;
+			diskCache->store(tileKey(r, state), *fresh[k]);
+		}
+		delete old;
+		imgCache.insert(r, fresh[k]);
+	}
+
+	// A refresh answers no request, it goes out as tileRefreshed so
+	// nobody takes it for the tile of a request still in flight
+	if(changed && receivers(SIGNAL(tileRefreshed(QRect, QImage*))) > 0) {
+		emit tileRefreshed(lastRequest, assembleTile(lastRequest));
+		packIdleTiles();
+		if(!diskTiles.isEmpty())
+			QMetaObject::invokeMethod(this, "verifyDiskTiles",
+				Qt::QueuedConnection);
+	}
+}
+
+void ParallelCoordsRenderManager::touchTile(QRect r)
+{
+	recentTiles.removeOne(r);
+	recentTiles.push_back(r);
+}
+
+ParallelCoordsRenderManager::packedTile 
+ParallelCoordsRenderManager::packTile(QRect r, QImage img, quint32 generation)
+{
+	packedTile p = {r, img.size(), ParallelCoordsRaster::pack(img), generation};
+	return p;
+}
+
+void ParallelCoordsRenderManager::packIdleTiles()
 {
+	// Only the most recently used tiles stay expanded, the others
+	// are packed on the pool. Until a packed copy is back the tile
+	// stays usable as it is.
+	int rawCnt = imgCache.count() - packingTiles.count();
+	for(int k=0; k<recentTiles.count() && rawCnt > rawTileLimit; k++) {
+		QRect r = recentTiles[k];
+		if(!imgCache.contains(r) || packingTiles.contains(r))
+			continue;
+
+		packingTiles.insert(r);
+		rawCnt--;
+		QFutureWatcher<packedTile> *watcher = new QFutureWatcher<packedTile>(this);
+		connect(watcher, SIGNAL(finished()), this, SLOT(tilePacked()));
+		watcher->setFuture(QtConcurrent::run(packTile, r, *imgCache[r],
+			cacheGeneration));
+	}
+}
+
+void ParallelCoordsRenderManager::tilePacked()
+{
+	QFutureWatcher<packedTile> *watcher = 
+		static_cast<QFutureWatcher<packedTile>*>(sender());
+	packedTile p = watcher->result();
+	watcher->deleteLater();
+
+	// The tile may have been flushed, replaced or used again meanwhile
+	if(p.generation != cacheGeneration || !packingTiles.remove(p.rect))
+		return;
+	if(recentTiles.indexOf(p.rect) >= recentTiles.count() - rawTileLimit)
+		return;
+
+	delete imgCache.take(p.rect);
+	packedCache.insert(p.rect, p);
+	packedBytes += p.bytes.size();
+
+	// oldest packed tiles go first once the budget is used up
+	for(int k=0; k<recentTiles.count() && packedBytes > packedLimit; ) {
+		QRect r = recentTiles[k];
+		if(packedCache.contains(r)) {
+			packedBytes -= packedCache.take(r).bytes.size();
+			recentTiles.removeAt(k);
+			dropPickIndex(r);
+		}
+		else {
+			k++;
+		}
+	}
+}
+
+QRect ParallelCoordsRenderManager::pickStrip(QRect tile) const
+{
+	// A pick index covers the whole height of the axes, every tile
+	// of a column of the grid would build the same one
+	return QRect(tile.left(), 0, tileSize, std::numeric_limits<int>::max());
+}
+
+void ParallelCoordsRenderManager::dropPickIndex(QRect tile)
+{
+	// only once no tile of its strip is cached any more
+	QRect strip = pickStrip(tile);
+	foreach(QRect r, recentTiles) {
+		if(pickStrip(r) == strip)
+			return;
+	}
+	removePickIndex(strip);
+}
+
+void ParallelCoordsRenderManager::cachePickIndex(QRect strip,
+	QSharedPointer<ParallelCoordsPickIndex> index)
+{
+	// Indexes take a few bytes per row and pair, far more than the
+	// tiles of their strip. The least recently picked go first once
+	// pickLimit is used up, the tiles stay.
+	removePickIndex(strip);
+	pickCache.insert(strip, index);
+	recentStrips.push_back(strip);
+	pickBytes += index->bytes();
+	while(pickBytes > pickLimit && recentStrips.count() > 1)
+		removePickIndex(recentStrips.first());
+}
+
+void ParallelCoordsRenderManager::removePickIndex(QRect strip)
+{
+	QSharedPointer<ParallelCoordsPickIndex> index = pickCache.take(strip);
+	if(index) {
+		pickBytes -= index->bytes();
+		recentStrips.removeOne(strip);
+	}
+}
+
+void ParallelCoordsRenderManager::renderTileJob(tileJob &job)
+{
+	job.img = job.manager->renderCoverage(*job.state,
+		job.manager->tileRect(job.tile), QSize(job.manager->tileSize,
+		job.manager->tileSize), job.pickIndex, job.memoryBudget);
+}
+
+bool ParallelCoordsRenderManager::fitsPickLimit(QRect tile,
+	renderState const& state) const
+{
+	QVector<renderData> *ppd = relevantAxes(tileRect(tile), state);
+	const qint64 bytes = ParallelCoordsPickIndex::buildBytes(
+		qMax(ppd->count() - 1, 0), state.data->length());
+	delete ppd;
+	return bytes <= pickLimit;
+}
+
+QVector<QImage*> ParallelCoordsRenderManager::renderTiles(
+	QList<QRect> const& tiles, renderState const& state)
+{
+	// One job per tile spread over the pool, each render still
+	// spreads its own work further. Tiles rendered at the same time
+	// share the memory limit.
+	const int concurrent = qMax(1, qMin(tiles.count(),
+		QThread::idealThreadCount()));
+	std::vector<tileJob> jobs;
+	QSet<QRect> indexed;
+	foreach(QRect r, tiles) {
+		// The pick index needs a few bytes per row, so it is only
+		// built for data that is held in memory anyway, by one tile of
+		// every strip and only if it fits in pickLimit at all
+		tileJob job = {this, &state, r, memoryLimit / concurrent,
+			nullptr, nullptr};
+		QRect strip = pickStrip(r);
+		if(!state.data->isOutOfCore() && !pickCache.contains(strip) &&
+		   !indexed.contains(strip) && fitsPickLimit(r, state)) {
+			job.pickIndex = new ParallelCoordsPickIndex(state.data);
+			indexed.insert(strip);
+		}
+		jobs.push_back(job);
+	}
+
+	if(jobs.size() > 1)
+		QtConcurrent::blockingMap(jobs, renderTileJob);
+	else if(!jobs.empty())
+		renderTileJob(jobs.front());
+
+	QVector<QImage*> images;
+	for(size_t k=0; k<jobs.size(); k++) {
+		if(jobs[k].pickIndex) {
+			cachePickIndex(pickStrip(jobs[k].tile),
+				QSharedPointer<ParallelCoordsPickIndex>(jobs[k].pickIndex));
+		}
+		images.push_back(jobs[k].img);
+	}
+	return images;
+}
+
+QImage* ParallelCoordsRenderManager::renderRegion(QRectF visible_rect,
+	QSize imgSize, ParallelCoordsPickIndex *pickIndex, int sharers) const
+{
+	const renderState state = currentState();
+	// The coverage image and its 32 bit copy are alive together and
+	// come out of the share of the limit as well
+	const qint64 imageBytes = static_cast<qint64>(imgSize.width()) *
+		imgSize.height() * (1 + 4);
+	QImage *coverage = renderCoverage(state, visible_rect, imgSize, pickIndex,
+		qMax(memoryLimit / qMax(sharers, 1) - imageBytes,
+			static_cast<qint64>(0)));
+	QImage *img = new QImage(coverage->convertToFormat(
+		QImage::Format_ARGB32_Premultiplied));
+	delete coverage;
+
+	QVector<renderData> *ppd = relevantAxes(visible_rect, state);
+	renderAxes(img, ppd, visible_rect);
+	delete ppd;
+	return img;
+}
+
+QImage* ParallelCoordsRenderManager::renderCoverage(QRectF visible_rect,
+	QSize imgSize, ParallelCoordsPickIndex *pickIndex) const
+{
+	return renderCoverage(currentState(), visible_rect, imgSize, pickIndex,
+		memoryLimit);
+}
+
+QImage* ParallelCoordsRenderManager::renderCoverage(renderState const& state,
+	QRectF visible_rect, QSize imgSize, ParallelCoordsPickIndex *pickIndex,
+	qint64 memoryBudget) const
+{
+	// Rows are streamed through in chunks so the projected data of a
+	// render never takes more than memoryBudget, whatever the data
+	// size. Chunks within one segment of the data are read in place.
+	// The buffers belong to this render and go with it, so lowering
+	// the limit takes effect with the next render.
+	QVector<renderData> *ppd = relevantAxes(visible_rect, state);
+	const int dataLength = state.data->length();
+	const int chunkRows = qMin(chunkLength(ppd->count(),
+		state.data->isOutOfCore(), memoryBudget), state.data->contiguousRows());
+
+	QImage *img = ParallelCoordsRaster::newCoverageImage(imgSize);
+
+	if(pickIndex)
+		pickIndex->begin(*ppd, dataLength);
+
+	renderChunk chunk;
+	renderScratch scratch;
+	for(int first=0; first<dataLength; first+=chunkRows) {
+		const int rowCnt = qMin(chunkRows, dataLength - first);
+		filterData(state.data.data(), state.mask.data(), ppd, first, rowCnt,
+			&chunk, &scratch);
+		renderImage(img, &chunk, ppd, visible_rect, &scratch);
+		if(pickIndex)
+			pickIndex->addChunk(chunk);
+	}
+
+	if(pickIndex)
+		pickIndex->finish();
+
+	delete ppd;
+	return img;
+}
+
+int ParallelCoordsRenderManager::chunkLength(int relevantAxisCnt,
+	bool readsColumns, qint64 memoryBudget) const
+{
+	// Per row and axis a chunk holds the column value read from a
+	// column file and the projected y. Each of the two bands
+	// rasterized at once holds a line with its row and merged pixel
+	// ends per axis pair of the wave being clipped. Every row also has
+	// its weight.
+	const qint64 lineBytes = sizeof(QLineF) + sizeof(int) +
+		sizeof(ParallelCoordsRaster::pixelSegment);
+	const qint64 axisCnt = qMax(relevantAxisCnt, 1);
+	const qint64 wave = qMin(axisCnt,
+		static_cast<qint64>(qMax(1, QThread::idealThreadCount())));
+	qint64 rowBytes = axisCnt * 
+		((readsColumns ? sizeof(qreal) : 0) + sizeof(qreal)) +
+		2 * wave * lineBytes + sizeof(quint32);
+	qint64 rows = memoryBudget / rowBytes;
+
+	// multiple of 64 keeps chunks aligned with anything kept per
+	// 64 rows, never less than that
+	rows = qMax(rows & ~static_cast<qint64>(63), static_cast<qint64>(64));
+	return static_cast<int>(qMin(rows, 
+		static_cast<qint64>(std::numeric_limits<int>::max() & ~63)));
+}
+
+void ParallelCoordsRenderManager::setMemoryLimit(qint64 bytes)
+{
+	memoryLimit = bytes;
+}
+
+QVector<renderData>* ParallelCoordsRenderManager::relevantAxes(
+	QRectF visible_rect, renderState const& state) const
+{
+	QVector<axis_view_data> const *axis_data = state.axes.data();
+	ParallelCoordsDataSnapshot const *data = state.data.data();
 	auto compare = [](axis_view_data const& a, axis_view_data const& b)
 	{
-		return a.pos.x() < b.pos.x();	
+		return a.x < b.x;	
 	};
 
 	// determine the axes just before the left and just after the right margins
-	axis_view_data left = {-1, QRectF(), QPointF(visible_rect.left(), -1)};
-	axis_view_data right = {-1, QRectF(), QPointF(visible_rect.right(), -1)};
+	axis_view_data left = {-1, visible_rect.left()};
+	axis_view_data right = {-1, visible_rect.right()};
 	auto start_pos = qLowerBound((*axis_data).begin(), 
 		(*axis_data).end(), left, compare);
 	auto end_pos = qLowerBound(start_pos, (*axis_data).end(), right, compare);
@@ -277,49 +807,101 @@ void ParallelCoordsRenderManager::filterData(
 			idx->index, 									// axis index
 			data->getRange(idx->index).first,				// min
 			data->getRange(idx->index).second,				// max
-			idx->pos.x(), 									// axis X
-			idx->pos.y(), 									// axis Y
-			idx->bounding_box.height()};					// axis height
+			idx->x, 										// axis X
+			0, 												// axis Y
+			static_cast<qreal>(canvasSize.height())};		// axis height
 			ppd->push_back(p);
 	}
 
+	return ppd;
+}
+
+void ParallelCoordsRenderManager::filterData(
+	ParallelCoordsDataSnapshot const *snapshot,
+	rowMask const *mask,
+	QVector<renderData> const *ppd,
+	int firstRow, int rowCnt,
+	renderChunk *chunk, renderScratch *scratch) const
+{
 	// Process Points
-	// Select -> Project -> construct polyline
-	// drawing polylines can be faster than drawing line segments
+	// Select -> Project, written in place into the scratch of
+	// the render
 	const int relevantAxisCnt = ppd->count();
-	const int dataLength = data->length();
-	auto *polyLineSet = new QVector<QPolygonF>;
-
-	for(int i=0; i<dataLength; i++) {
-		QPolygonF polyLine;
-		for(int j=0; j<relevantAxisCnt; j++) {
-			QPointF pt;
-			const renderData &pp = (*ppd)[j];
-			pt.setX(pp.axis_x);
-			pt.setY(((*data)[i][pp.index] - pp.data_min) * (pp.axis_height) / 
-				(pp.data_max - pp.data_min) + (pp.axis_y));
-			polyLine << pt;
+	if(scratch->columnBuffers.count() < relevantAxisCnt) {
+		scratch->columnBuffers.resize(relevantAxisCnt);
+		scratch->columns.resize(relevantAxisCnt);
+	}
+	scratch->ys.resize(static_cast<size_t>(relevantAxisCnt) * rowCnt);
+
+	// Only the columns of the relevant axes are read, missing values
+	// come out as NaN and project to NaN. Rows in memory are projected
+	// where they are, compressed ones decoded on the way, only column
+	// files and shared memory are read into a chunk first.
+	const bool inPlace = snapshot->canProject();
+	for(int j=0; j<relevantAxisCnt; j++) {
+		scratch->columns[j] = inPlace ? nullptr :
+			snapshot->columnChunk((*ppd)[j].index, firstRow, rowCnt,
+				scratch->columnBuffers[j]);
+	}
+
+	// Columns are cut into blocks that fit in L2, small chunks are not
+	// worth waking the pool for
+	std::vector<projectionJob> jobs;
+	for(int j=0; j<relevantAxisCnt; j++) {
+		const renderData &pp = (*ppd)[j];
+		qreal *y = scratch->ys.data() + static_cast<size_t>(j) * rowCnt;
+		for(int first=0; first<rowCnt; first+=projectionBlockRows) {
+			projectionJob job = {
+				inPlace ? nullptr : scratch->columns[j] + first,
+				y + first,
+				qMin(projectionBlockRows, rowCnt - first),
+				pp.data_min,
+				pp.axis_height / (pp.data_max - pp.data_min),
+				pp.axis_y,
+				snapshot,
+				pp.index,
+				firstRow + first};
+			jobs.push_back(job);
 		}
-		polyLineSet->push_back(polyLine);
 	}
+	if(jobs.size() > 1)
+		QtConcurrent::blockingMap(jobs, runProjection);
+	else if(!jobs.empty())
+		runProjection(jobs.front());
 
-	*ppd_ptr = ppd;
-	*polyLineSet_ptr = polyLineSet;
-}
+	// A row is drawn on an axis if it has a value there and neither the
+	// filter of the data nor the mask of the view leaves it out, a bit
+	// per row. Segments are then picked by whole words of these.
+	const int words = (rowCnt + 63) / 64;
+	scratch->drawn.resize(static_cast<size_t>(relevantAxisCnt) * words);
+	ParallelCoordsRowMask selection = snapshot->selection();
+	for(int j=0; j<relevantAxisCnt; j++) {
+		quint64 *bits = scratch->drawn.data() + static_cast<size_t>(j) * words;
+		if(inPlace)
+			memcpy(bits, snapshot->validityChunk((*ppd)[j].index, firstRow,
+				rowCnt, scratch->validity), words * sizeof(quint64));
+		else
+			validWords(scratch->columns[j], rowCnt, bits);
+		if(selection)
+			maskWords(selection.data(), firstRow, words, bits);
+		if(mask)
+			maskWords(mask, firstRow, words, bits);
+	}
 
-QImage* ParallelCoordsRenderManager::renderImage(
-	QVector<QPolygonF> *polyLineSet, 
-	QVector<renderData> *ppd, 
-	// When anchor margins were under this function
-	// it made sense to make viewport adjustments to 
-	// appropriately draw the axis anchors. not needed
-	// currently as this does not play well with the idea of tiling
-// 	QRectF visible_rect, QSizeF parentViewportSize)
-// {
-// 	QSizeF viewportSize = parentViewportSize;
-// 	viewportSize.setHeight(viewportSize.height() - 2.0 * axisAnchorMargin);
+	chunk->firstRow = firstRow;
+	chunk->rowCnt = rowCnt;
+	chunk->axisCnt = relevantAxisCnt;
+	chunk->ys = scratch->ys.data();
+	chunk->drawn = scratch->drawn.data();
+	chunk->weights = snapshot->weightChunk(firstRow, rowCnt, scratch->weights);
+}
 
-	QRectF visible_rect, QSizeF viewportSize)
+// Paints one chunk of polylines on top of what img already holds
+void ParallelCoordsRenderManager::renderImage(
+	QImage *img,
+	renderChunk const *chunk, 
+	QVector<renderData> const *ppd, 
+	QRectF visible_rect, renderScratch *scratch) const
 {
 	QRectF zone1, zone2, zone3, zone4;
 	zone1 = visible_rect;
@@ -330,18 +912,33 @@ QImage* ParallelCoordsRenderManager::renderImage(
 	zone4.translate(zone1.bottomRight());
 	int zoneCnt[4] = {0};
 
-	const int relevantAxisCnt = ppd->count();
-	const int polyLineCnt = polyLineSet->count();
+	const int relevantAxisCnt = chunk->axisCnt;
+	const int polyLineCnt = chunk->rowCnt;
+
+	if(!polyLineCnt)
+		return;
+
+	rasterJob job = {img->bits(), img->bytesPerLine(), img->size(),
+		img->rect(), visible_rect, chunk, ppd, threadingThreshold,
+		collapseThreshold, &scratch->bands[0]};
 
-	for(int i=0; i<polyLineCnt; i++) {
-		for(int j=0; j<relevantAxisCnt; j++) {
-			if(zone1.contains((*polyLineSet)[i][j]))
+	if((polyLineCnt * (relevantAxisCnt-1) < threadingThreshold)) {
+		renderPolylines(job);
+		return;
+	}
+
+	for(int j=0; j<relevantAxisCnt; j++) {
+		const qreal x = (*ppd)[j].axis_x;
+		qreal const *y = chunk->ys + j * polyLineCnt;
+		for(int i=0; i<polyLineCnt; i++) {
+			QPointF pt(x, y[i]);
+			if(zone1.contains(pt))
 				zoneCnt[0]++;
-			else if(zone2.contains((*polyLineSet)[i][j]))
+			else if(zone2.contains(pt))
 				zoneCnt[1]++;
-			else if(zone3.contains((*polyLineSet)[i][j]))
+			else if(zone3.contains(pt))
 				zoneCnt[2]++;
-			else if(zone4.contains((*polyLineSet)[i][j]))
+			else if(zone4.contains(pt))
 				zoneCnt[3]++;
 		}
 	}
@@ -350,80 +947,36 @@ QImage* ParallelCoordsRenderManager::renderImage(
 	int vertical_bias = 
 	qAbs((zoneCnt[0] + zoneCnt[2]) - (zoneCnt[1] + zoneCnt[3]));
 
-	QImage *img = new QImage(viewportSize.toSize(), QImage::Format_ARGB32_Premultiplied);
-
-	if(polyLineSet->count()) {
-		if((polyLineCnt * (relevantAxisCnt-1) < threadingThreshold)) {
-			renderPolylines(img, visible_rect, polyLineSet);
-		}
-		else { // Now we are going to use threads and paint
-			if(horizontal_bias < vertical_bias) { // split horizontally
-				QImage *img1 = new QImage(viewportSize.width(), 
-					viewportSize.height()/2.0, QImage::Format_ARGB32_Premultiplied); 
-				QImage *img2 = new QImage(viewportSize.width(), 
-					viewportSize.height()/2.0, QImage::Format_ARGB32_Premultiplied);
-				QRectF rect1, rect2;
-				rect1 = visible_rect;
-				rect1.setHeight(visible_rect.height()/2.0);
-				rect2 = rect1;
-				rect2.translate(0.0, rect1.height());
-
-				auto r = QtConcurrent::run(renderPolylines, 
-										   img1, 
-										   rect1, 
-										   polyLineSet);
-				renderPolylines(img2, rect2, polyLineSet);
-				r.waitForFinished();
-
-				QPainter painter;
-				{
-					bool stat = painter.begin(img);
-					Q_ASSERT(stat);
-				}
-				painter.drawImage(0, 0, *img1);
-				painter.drawImage(0,viewportSize.height()/2.0, *img2);
-				painter.end();
-
-				delete img1;
-				delete img2;
-			}
-			else { // split vertically
-				QImage *img1 = new QImage(viewportSize.width()/2.0, 
-					viewportSize.height(), QImage::Format_ARGB32_Premultiplied);
-				QImage *img2 = new QImage(viewportSize.width()/2.0, 
-					viewportSize.height(), QImage::Format_ARGB32_Premultiplied);
-				QRectF rect1, rect2;
-				rect1 = visible_rect;
-				rect1.setWidth(visible_rect.width()/2.0);
-				rect2 = rect1;
-				rect2.translate(rect1.width(), 0.0);
-
-				auto r = QtConcurrent::run(renderPolylines, 
-										   img1, 
-										   rect1, 
-										   polyLineSet);
-				renderPolylines(img2, rect2, polyLineSet);
-				r.waitForFinished();
-
-				QPainter painter;
-				{
-					bool stat = painter.begin(img);
-					Q_ASSERT(stat);
-				}
-				painter.drawImage(0, 0, *img1);
-				painter.drawImage(viewportSize.width()/2.0, 0, *img2);
-				painter.end();
-
-				delete img1;
-				delete img2;
-			}
-		}
+	// Now we are going to use threads and paint
+	// both halves draw straight into their own band of img
+	const int width = img->width(), height = img->height();
+	rasterJob job1 = job, job2 = job;
+	job2.scratch = &scratch->bands[1];
+	if(horizontal_bias < vertical_bias) { // split horizontally
+		job1.band = QRect(0, 0, width, height/2);
+		job2.band = QRect(0, height/2, width, height - height/2);
+	}
+	else { // split vertically
+		job1.band = QRect(0, 0, width/2, height);
+		job2.band = QRect(width/2, 0, width - width/2, height);
 	}
 
+	auto r = QtConcurrent::run(renderPolylines, job1);
+	renderPolylines(job2);
+	r.waitForFinished();
+}
+
+void ParallelCoordsRenderManager::renderAxes(
+	QImage *img,
+	QVector<renderData> const *ppd,
+	QRectF visible_rect) const
+{
 	// draw all axis
 	// We want a constant width axis at all scale levels
 	// so we do all the scaling and translation manually before
 	// drawing. 
+	QSizeF viewportSize = img->size();
+	const int relevantAxisCnt = ppd->count();
 	QTransform t;
 	t.scale(viewportSize.width()/visible_rect.width(),
 			viewportSize.height()/visible_rect.height());
@@ -449,8 +1002,6 @@ QImage* ParallelCoordsRenderManager::renderImage(
 	painter.drawLines(axisLines);
 	painter.end();
 
-	return img;
-
 	// Axis margins don't play well with tiling
 	// this has to be done in the final viewport
 	// reverting back to the old ways
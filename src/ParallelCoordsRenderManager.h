@@ -5,45 +5,164 @@
 #include "ParallelCoordinates.h"
 #include "QParallelCoordsData.h"
 #include "ParallelCoordsViewPrivate.h"
+#include "ParallelCoordsPickIndex.h"
+#include "ParallelCoordsDiskCache.h"
+#include "ParallelCoordsPublished.h"
+
+class ParallelCoordsRenderService;
 
 class ParallelCoordsRenderManager : public QObject
 {
 	Q_OBJECT
 public:
+	// density is in device pixels per canvas unit
 	ParallelCoordsRenderManager(QSize canvasSize,
-								QPair<qreal, qreal> scaleFactors,
+								QPair<qreal, qreal> density,
 								QSize viewportSize,
-								QList<axis_view_data> const *axis_data,
+								ParallelCoordsLayout layout,
 								QParallelCoordsData const* data);
 
+	// Thread safe. Renders started later use the new layout, the ones
+	// running finish with the one they started with.
+	void setLayout(ParallelCoordsLayout layout);
+	// Thread safe as well, only the rows in mask are drawn and picked
+	// from then on, nullptr draws them all
+	void setRowMask(ParallelCoordsRowMask mask);
+
+	// Renders a region of the canvas into a new image of imgSize.
+	// Touches no caches so it can be called from other threads, the
+	// memory limit is split evenly between sharers renders that run
+	// at the same time.
+	QImage* renderRegion(QRectF visible_rect, QSize imgSize,
+		ParallelCoordsPickIndex *pickIndex = nullptr, int sharers = 1) const;
+	// Same without the axes, as an 8 bit coverage image
+	QImage* renderCoverage(QRectF visible_rect, QSize imgSize,
+		ParallelCoordsPickIndex *pickIndex = nullptr) const;
+
+	QParallelCoordsData const* getData() const;
+	// Tiles are looked up in and handed to the service before the
+	// disk cache, nullptr renders on its own
+	void setService(ParallelCoordsRenderService *service);
+
 public slots:
 	void getTile(QRect rect);
 	void viewportSizeChange(QSize viewportSize);
-	void scaleFactorsChange(QPair<qreal, qreal> scaleFactors);
+	void densityChange(QPair<qreal, qreal> density);
 	void canvasSizeChange(QSize canvasSize);
 	void axisDataChange();
+	void rowMaskChange();
+	void pick(QPointF pt, qreal tolerance);
+	void setMemoryLimit(qint64 bytes);
+
+private slots:
+	void verifyDiskTiles();
+	void tilePacked();
 
 signals:
+	// The tile asked for by getTile
 	void tileGenerated(QRect r, QImage *img);
+	// The last tile again, a tile of it read from the disk cache was
+	// stale. Answers no request.
+	void tileRefreshed(QRect r, QImage *img);
+	void rowsPicked(QPointF pt, QVector<int> rows);
 
 private:
 	QSize canvasSize;
-	QPair<qreal, qreal> scaleFactors;
+	QPair<qreal, qreal> density;
 	QSize viewportSize;
-	QHash<QRect,QImage*> imgCache;
+	int tileSize;		// device pixels, tiles are square
+	struct packedTile {
+		QRect rect;
+		QSize size;
+		QByteArray bytes;
+		quint32 generation;
+	};
+
+	QHash<QRect,QImage*> imgCache;			// keyed by device pixel rect
+	QHash<QRect,packedTile> packedCache;	// idle tiles, run length coded
+	QList<QRect> recentTiles;				// both tiers, least recent first
+	QSet<QRect> packingTiles;
+	int rawTileLimit;
+	qint64 packedLimit;
+	qint64 packedBytes;
+	quint32 cacheGeneration;
+	QHash<QRect,QSharedPointer<ParallelCoordsPickIndex>> pickCache;	// per strip
+	QList<QRect> recentStrips;				// of pickCache, least recent first
+	qint64 pickLimit;
+	qint64 pickBytes;
 	QParallelCoordsData const *data;
 	int threadingThreshold;
+	int collapseThreshold;	// lines per pixel row of a band before lines
+							// with the same pixel ends are merged
+	quint32 tileFormat;		// part of the tile keys, bumped on format changes
+	int projectionBlockRows;
 	int axisPenWidth;
+	int maxPickedRows;
+	qint64 memoryLimit;	// bytes of projected data, shared by the tiles
+						// rendered at once
+	ParallelCoordsDiskCache *diskCache;
+	ParallelCoordsRenderService *service;
+	QList<QRect> diskTiles;		// shown from disk, not yet verified
+	QRect lastRequest;
+
+	// What one render reads, taken once as it starts
+	struct renderState {
+		ParallelCoordsLayout axes;
+		ParallelCoordsDataSnapshot::pointer data;
+		ParallelCoordsRowMask mask;
+	};
+	ParallelCoordsPublished<QVector<axis_view_data>> layout;
+	ParallelCoordsPublished<rowMask> visibleRows;
+
+	renderState currentState() const;
+	QByteArray tileKey(QRect r, renderState const& state) const;
+
+	// One tile rendered on the pool
+	struct tileJob {
+		ParallelCoordsRenderManager const *manager;
+		renderState const *state;
+		QRect tile;
+		qint64 memoryBudget;
+		QImage *img;
+		ParallelCoordsPickIndex *pickIndex;
+	};
 
+	QImage* assembleTile(QRect rect);
+	QRectF tileRect(QRect tile) const;
+	QRect pickStrip(QRect tile) const;
+	void dropPickIndex(QRect tile);
+	void cachePickIndex(QRect strip,
+		QSharedPointer<ParallelCoordsPickIndex> index);
+	void removePickIndex(QRect strip);
+	bool fitsPickLimit(QRect tile, renderState const& state) const;
+	QVector<QImage*> renderTiles(QList<QRect> const& tiles,
+		renderState const& state);
+	static void renderTileJob(tileJob &job);
+	QImage* renderCoverage(renderState const& state, QRectF visible_rect,
+		QSize imgSize, ParallelCoordsPickIndex *pickIndex,
+		qint64 memoryBudget) const;
+	void touchTile(QRect r);
+	void packIdleTiles();
+	static packedTile packTile(QRect r, QImage img, quint32 generation);
+	int chunkLength(int relevantAxisCnt, bool readsColumns,
+		qint64 memoryBudget) const;
+	QVector<renderData>* relevantAxes(QRectF visible_rect,
+		renderState const& state) const;
 	void filterData(
-		QRectF visible_rect,
-		QVector<renderData> **ppd_ptr,
-		QVector<QPolygonF> **polyLineSet_ptr);
-	QImage* renderImage(
-		QVector<QPolygonF> *polyLineSet, 
-		QVector<renderData> *ppd, 
-		QRectF visible_rect, QSizeF parentViewportSize);
-	QList<axis_view_data> const *axis_data;
+		ParallelCoordsDataSnapshot const *snapshot,
+		rowMask const *mask,
+		QVector<renderData> const *ppd,
+		int firstRow, int rowCnt,
+		renderChunk *chunk, renderScratch *scratch) const;
+	void renderImage(
+		QImage *img,
+		renderChunk const *chunk, 
+		QVector<renderData> const *ppd, 
+		QRectF visible_rect, renderScratch *scratch) const;
+	void renderAxes(
+		QImage *img,
+		QVector<renderData> const *ppd,
+		QRectF visible_rect) const;
 
 	void flushCache();
 
@@ -0,0 +1,140 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsRenderService.h"
+
+QHash<QParallelCoordsData const*, ParallelCoordsRenderService*> 
+	ParallelCoordsRenderService::services;
+
+ParallelCoordsRenderService::ParallelCoordsRenderService(
+	QParallelCoordsData const *data_)
+: data(data_), viewCnt(0), rendering(nullptr), activeStreak(0)
+{
+	maxSharedTiles = 64;
+	maxActiveStreak = 4;
+	renderThread = new ParallelCoordsRenderThread(this);
+	renderThread->start();
+}
+
+ParallelCoordsRenderService::~ParallelCoordsRenderService()
+{
+	delete renderThread;
+}
+
+ParallelCoordsRenderService* ParallelCoordsRenderService::attach(
+	QObject *view, ParallelCoordsRenderManager *renderManager)
+{
+	// Views live on the gui thread, so does the registry
+	QParallelCoordsData const *data = renderManager->getData();
+	ParallelCoordsRenderService *service = services.value(data);
+	if(service == nullptr) {
+		service = new ParallelCoordsRenderService(data);
+		services.insert(data, service);
+	}
+
+	service->viewCnt++;
+	service->managers.insert(view, renderManager);
+	renderManager->setService(service);
+	service->renderThread->attach(view, renderManager);
+	connect(view, SIGNAL(requestTile(QRect)), service, SLOT(request(QRect)));
+	connect(renderManager, SIGNAL(tileGenerated(QRect, QImage*)),
+			service, SLOT(tileDone()));
+	connect(service, SIGNAL(brushed(QVector<int>)), 
+			view, SLOT(setBrushedRows(QVector<int>)));
+	return service;
+}
+
+void ParallelCoordsRenderService::detach(QObject *view,
+	ParallelCoordsRenderManager *renderManager)
+{
+	disconnect(this, 0, view, 0);
+	disconnect(view, 0, this, 0);
+	disconnect(renderManager, 0, this, 0);
+	managers.remove(view);
+	requests.remove(view);
+	waiting.removeOne(view);
+	if(rendering == renderManager) {
+		rendering = nullptr;
+		dispatch();
+	}
+	renderThread->detach(view, renderManager);
+	if(--viewCnt == 0) {
+		services.remove(data);
+		delete this;
+	}
+}
+
+bool ParallelCoordsRenderService::findTile(QByteArray const& key,
+	sharedTile *result)
+{
+	if(!tiles.contains(key))
+		return false;
+	*result = tiles[key];
+	return true;
+}
+
+void ParallelCoordsRenderService::shareTile(QByteArray const& key,
+	sharedTile const& t)
+{
+	if(!tiles.contains(key))
+		tileOrder.push_back(key);
+	tiles.insert(key, t);
+	while(tileOrder.count() > maxSharedTiles)
+		tiles.remove(tileOrder.takeFirst());
+}
+
+void ParallelCoordsRenderService::request(QRect r)
+{
+	// a view has one request at a time, a new one replaces the last
+	QObject *view = sender();
+	if(!requests.contains(view))
+		waiting.push_back(view);
+	requests.insert(view, r);
+	dispatch();
+}
+
+void ParallelCoordsRenderService::tileDone()
+{
+	// Managers also send tiles nobody asked for, after verifying
+	// tiles from the disk cache
+	if(sender() != rendering)
+		return;
+	rendering = nullptr;
+	dispatch();
+}
+
+void ParallelCoordsRenderService::dispatch()
+{
+	if(rendering || waiting.isEmpty())
+		return;
+
+	// The active window first unless it had its streak and others
+	// have been waiting longer
+	int next = 0;
+	for(int i=0; i<waiting.count(); i++) {
+		QWidget *w = qobject_cast<QWidget*>(waiting[i]);
+		if(w && w->isActiveWindow()) {
+			if(i == 0 || activeStreak < maxActiveStreak)
+				next = i;
+			break;
+		}
+	}
+	QWidget *w = qobject_cast<QWidget*>(waiting[next]);
+	activeStreak = w && w->isActiveWindow() ? activeStreak + 1 : 0;
+
+	QObject *view = waiting.takeAt(next);
+	rendering = managers.value(view);
+	QMetaObject::invokeMethod(rendering, "getTile", Qt::QueuedConnection,
+		Q_ARG(QRect, requests.take(view)));
+}
+
+QVector<int> ParallelCoordsRenderService::brushedRows() const
+{
+	return brushRows;
+}
+
+void ParallelCoordsRenderService::brush(QVector<int> rows)
+{
+	if(rows == brushRows)
+		return;
+	brushRows = rows;
+	emit brushed(rows);
+}
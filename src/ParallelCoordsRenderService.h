@@ -0,0 +1,73 @@
+#ifndef __PARALLELCOORDSRENDERSERVICE_H__
+#define __PARALLELCOORDSRENDERSERVICE_H__
+
+#include "ParallelCoordinates.h"
+#include "QParallelCoordsData.h"
+#include "ParallelCoordsRenderThread.h"
+#include "ParallelCoordsPickIndex.h"
+
+// Shared by all views of one data store. Their render managers run on
+// one render thread and the global pool, tiles and pick indices one
+// view has rendered are handed to any other view asking for the same
+// tile, and rows brushed in one view are highlighted in all of them.
+//
+// Tile requests go through the service, which hands the render thread
+// one at a time. The view in the active window goes first, but only
+// for a few tiles in a row while others wait, the rest are served in
+// the order they asked.
+class ParallelCoordsRenderService : public QObject
+{
+	Q_OBJECT
+
+public:
+	struct sharedTile {
+		QImage tile;
+		QSharedPointer<ParallelCoordsPickIndex> pickIndex;
+	};
+
+	// The service of data, created with the first view of it and
+	// deleted with the last one
+	static ParallelCoordsRenderService* attach(QObject *view,
+		ParallelCoordsRenderManager *renderManager);
+	void detach(QObject *view, ParallelCoordsRenderManager *renderManager);
+
+	// Only called from the render thread, so not locked
+	bool findTile(QByteArray const& key, sharedTile *result);
+	void shareTile(QByteArray const& key, sharedTile const& t);
+
+	QVector<int> brushedRows() const;
+
+public slots:
+	void brush(QVector<int> rows);
+
+private slots:
+	void request(QRect r);
+	void tileDone();
+
+signals:
+	void brushed(QVector<int> rows);
+
+private:
+	ParallelCoordsRenderService(QParallelCoordsData const *data);
+	~ParallelCoordsRenderService();
+
+	QParallelCoordsData const *data;
+	ParallelCoordsRenderThread *renderThread;
+	int viewCnt;
+	QHash<QByteArray, sharedTile> tiles;
+	QList<QByteArray> tileOrder;		// least recently shared first
+	int maxSharedTiles;
+	QVector<int> brushRows;
+	QHash<QObject*, ParallelCoordsRenderManager*> managers;
+	QHash<QObject*, QRect> requests;
+	QList<QObject*> waiting;		// views with a request, oldest first
+	ParallelCoordsRenderManager *rendering;	// nullptr when idle
+	int activeStreak;				// tiles of the active view in a row
+	int maxActiveStreak;
+
+	void dispatch();
+
+	static QHash<QParallelCoordsData const*, ParallelCoordsRenderService*> services;
+};
+
+#endif
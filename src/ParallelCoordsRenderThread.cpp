@@ -1,34 +1,53 @@
-
 #include "ParallelCoordinates.h"
 #include "ParallelCoordsRenderThread.h"
 #include "ParallelCoordsViewPrivate.h"
 
-ParallelCoordsRenderThread::ParallelCoordsRenderThread(
-	QObject *parent,
-	ParallelCoordsRenderManager *renderManager_)
+ParallelCoordsRenderThread::ParallelCoordsRenderThread(QObject *parent)
 : QThread(parent)
 {
-	renderManager = renderManager_;
-	renderManager->moveToThread(this);
-
-	qRegisterMetaType<QList<axis_view_data>>("QList<axis_view_data>");
+	qRegisterMetaType<QVector<axis_view_data>>("QVector<axis_view_data>");
 	qRegisterMetaType<QPair<qreal, qreal>>("QPair<qreal, qreal>");
+	qRegisterMetaType<QVector<int>>("QVector<int>");
+}
+
+ParallelCoordsRenderThread::~ParallelCoordsRenderThread()
+{
+	// pending deletes of detached managers run before the loop exits
+	quit();
+	wait();
+}
+
+void ParallelCoordsRenderThread::attach(QObject *view,
+	ParallelCoordsRenderManager *renderManager)
+{
+	renderManager->moveToThread(this);
 
-	connect(parent, SIGNAL(requestTile(QRect)), 
-			renderManager, SLOT(getTile(QRect)));
 	connect(renderManager, SIGNAL(tileGenerated(QRect, QImage*)),
-			parent, SLOT(renderTile(QRect, QImage*)));
-	connect(parent, SIGNAL(scaleFactorsChange(QPair<qreal, qreal>)),
-			renderManager, SLOT(scaleFactorsChange(QPair<qreal, qreal>)));
-	connect(parent, SIGNAL(viewportSizeChange(QSize)),
+			view, SLOT(renderTile(QRect, QImage*)));
+	connect(renderManager, SIGNAL(tileRefreshed(QRect, QImage*)),
+			view, SLOT(refreshTile(QRect, QImage*)));
+	connect(view, SIGNAL(densityChange(QPair<qreal, qreal>)),
+			renderManager, SLOT(densityChange(QPair<qreal, qreal>)));
+	connect(view, SIGNAL(viewportSizeChange(QSize)),
 			renderManager, SLOT(viewportSizeChange(QSize)));
-	connect(parent, SIGNAL(canvasSizeChange(QSize)),
+	connect(view, SIGNAL(canvasSizeChange(QSize)),
 			renderManager, SLOT(canvasSizeChange(QSize)));
-	connect(parent, SIGNAL(axisDataChange()),
+	connect(view, SIGNAL(axisDataChange()),
 			renderManager, SLOT(axisDataChange()));
+	connect(view, SIGNAL(rowMaskChange()),
+			renderManager, SLOT(rowMaskChange()));
+	connect(view, SIGNAL(memoryLimitChange(qint64)),
+			renderManager, SLOT(setMemoryLimit(qint64)));
+	connect(view, SIGNAL(requestPick(QPointF, qreal)),
+			renderManager, SLOT(pick(QPointF, qreal)));
+	connect(renderManager, SIGNAL(rowsPicked(QPointF, QVector<int>)),
+			view, SLOT(pickResult(QPointF, QVector<int>)));
 }
 
-ParallelCoordsRenderThread::~ParallelCoordsRenderThread()
+void ParallelCoordsRenderThread::detach(QObject *view,
+	ParallelCoordsRenderManager *renderManager)
 {
-	delete renderManager;
-}
\ No newline at end of file
+	disconnect(view, 0, renderManager, 0);
+	disconnect(renderManager, 0, view, 0);
+	renderManager->deleteLater();
+}
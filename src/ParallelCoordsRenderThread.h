@@ -2,19 +2,22 @@
 #define __PARELLELCOORDSRENDERTHREAD_H__
 
 #include "ParallelCoordinates.h"
-#include "ParallelCoordsRenderThread.h"
 #include "ParallelCoordsRenderManager.h"
 
+// Event loop the render managers of all views of one data store run
+// on. Tile requests reach it through ParallelCoordsRenderService,
+// which decides whose turn it is.
 class ParallelCoordsRenderThread : public QThread
 {
 public:
-	ParallelCoordsRenderThread(
-		QObject *parent,
-		ParallelCoordsRenderManager *renderManager);
+	ParallelCoordsRenderThread(QObject *parent);
 	~ParallelCoordsRenderThread();
 
-private:
-	ParallelCoordsRenderManager *renderManager;
+	// Moves renderManager to this thread and wires it to view, all
+	// but the tile requests
+	void attach(QObject *view, ParallelCoordsRenderManager *renderManager);
+	// Cuts the wires, renderManager is deleted on this thread
+	void detach(QObject *view, ParallelCoordsRenderManager *renderManager);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,84 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsReplay.h"
+#include "QParallelCoordsWidget.h"
+
+ParallelCoordsReplay::ParallelCoordsReplay(QObject *parent,
+	ParallelCoordsTrace const *trace_, QParallelCoordsWidget *view_)
+: QObject(parent), trace(trace_), view(view_)
+{
+	next = 0;
+	settleMsecs = 10000;
+	lastEventMsecs = 0;
+	staleFrames = 0;
+	droppedFrames = 0;
+	timer = new QTimer(this);
+	timer->setInterval(1);
+	connect(timer, SIGNAL(timeout()), this, SLOT(tick()));
+}
+
+void ParallelCoordsReplay::start()
+{
+	connect(view, SIGNAL(framePresented(qint64, bool)), 
+			this, SLOT(framePresented(qint64, bool)));
+	connect(view, SIGNAL(frameDropped()), this, SLOT(frameDropped()));
+	next = 0;
+	latencies.clear();
+	staleFrames = 0;
+	droppedFrames = 0;
+	clock.start();
+	timer->start();
+}
+
+void ParallelCoordsReplay::tick()
+{
+	QList<ParallelCoordsTrace::event> const& events = trace->events();
+	const qint64 now = clock.elapsed();
+	while(next < events.count() && events[next].msecs <= now) {
+		view->replay(events[next++]);
+		lastEventMsecs = now;
+	}
+
+	if(next < events.count())
+		return;
+	if(!view->isIdle() && now - lastEventMsecs < settleMsecs)
+		return;
+
+	timer->stop();
+	disconnect(view, SIGNAL(framePresented(qint64, bool)), 
+			   this, SLOT(framePresented(qint64, bool)));
+	disconnect(view, SIGNAL(frameDropped()), this, SLOT(frameDropped()));
+	emit finished(report());
+}
+
+void ParallelCoordsReplay::framePresented(qint64 latencyMsecs, bool stale)
+{
+	latencies.push_back(latencyMsecs);
+	if(stale)
+		staleFrames++;
+}
+
+void ParallelCoordsReplay::frameDropped()
+{
+	droppedFrames++;
+}
+
+QString ParallelCoordsReplay::report() const
+{
+	if(latencies.isEmpty())
+		return QString("%1 events, no frames, %2 dropped")
+			.arg(trace->events().count()).arg(droppedFrames);
+
+	// Nearest rank percentiles
+	QVector<qint64> sorted = latencies;
+	qSort(sorted);
+	const int n = sorted.count();
+	auto percentile = [&sorted, n](int p) {
+		return sorted[qMin(n-1, (n*p + 99)/100 - 1)];
+	};
+
+	return QString("%1 events, %2 frames, %3 stale, %4 dropped, latency ms "
+				   "p50 %5 p95 %6 p99 %7 max %8")
+		.arg(trace->events().count()).arg(n).arg(staleFrames)
+		.arg(droppedFrames).arg(percentile(50)).arg(percentile(95))
+		.arg(percentile(99)).arg(sorted[n-1]);
+}
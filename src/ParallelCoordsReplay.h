@@ -0,0 +1,45 @@
+#ifndef __PARALLELCOORDSREPLAY_H__
+#define __PARALLELCOORDSREPLAY_H__
+
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsTrace.h"
+
+class QParallelCoordsWidget;
+
+// Plays a trace back against a view at the recorded pace and collects
+// how long every frame took from request to screen. Once the last
+// event has been applied and the view settled, finished() hands over
+// a one line report.
+class ParallelCoordsReplay : public QObject
+{
+	Q_OBJECT
+
+public:
+	ParallelCoordsReplay(QObject *parent, ParallelCoordsTrace const *trace,
+		QParallelCoordsWidget *view);
+
+	void start();
+	QString report() const;
+
+signals:
+	void finished(QString report);
+
+private slots:
+	void tick();
+	void framePresented(qint64 latencyMsecs, bool stale);
+	void frameDropped();
+
+private:
+	ParallelCoordsTrace const *trace;
+	QParallelCoordsWidget *view;
+	QTimer *timer;
+	QElapsedTimer clock;
+	int next;					// first event not applied yet
+	qint64 settleMsecs;			// longest wait for the last frame
+	qint64 lastEventMsecs;
+	QVector<qint64> latencies;
+	int staleFrames;
+	int droppedFrames;
+};
+
+#endif
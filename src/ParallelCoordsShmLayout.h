@@ -0,0 +1,31 @@
+#ifndef __PARALLELCOORDSSHMLAYOUT_H__
+#define __PARALLELCOORDSSHMLAYOUT_H__
+
+// Shared with producer processes, which need not use Qt
+#include <atomic>
+#include <stdint.h>
+
+// A POSIX shared memory segment a producer fills with rows while the
+// viewer maps it and reads the columns in place. Behind the header
+// come axisCnt NUL terminated names of nameBytes each, then from
+// dataOffset one column of capacity doubles per axis, NaN for missing
+// values. Rows below published are complete and never change again:
+// a producer writes the values first and then raises published with
+// a release store.
+struct ParallelCoordsShmHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t axisCnt;
+	int32_t nameBytes;
+	int64_t capacity;
+	int64_t dataOffset;				// 64 byte aligned
+	int64_t createdMsecs;			// tells segments of one name apart
+	std::atomic<int64_t> published;
+	std::atomic<int32_t> closed;	// no more rows will come
+};
+
+static const uint32_t parallelCoordsShmMagic = 0x50435331;	// "PCS1"
+static const uint32_t parallelCoordsShmVersion = 1;
+static const int32_t parallelCoordsShmNameBytes = 64;
+
+#endif
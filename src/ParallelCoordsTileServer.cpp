@@ -0,0 +1,278 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsTileServer.h"
+
+ParallelCoordsTileServer::ParallelCoordsTileServer(QObject *parent)
+: QObject(parent)
+{
+	data = new QParallelCoordsData(this);
+	server = new QLocalServer(this);
+	maxViews = 16;
+	maxSocketTiles = 16;
+	maxQueuedTiles = 256;
+	maxTilePixels = 4096 * 4096;
+	rendering.answer = nullptr;
+	renderingManager = nullptr;
+	renderThread = new ParallelCoordsRenderThread(this);
+	renderThread->start();
+	connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+ParallelCoordsTileServer::~ParallelCoordsTileServer()
+{
+	// the managers are deleted on the render thread before it stops
+	foreach(viewState *v, views.values()) {
+		v->renderManager->deleteLater();
+		delete v;
+	}
+	delete renderThread;
+	foreach(reply *r, replies) {
+		delete r;
+	}
+}
+
+bool ParallelCoordsTileServer::load(QString fname)
+{
+	if(QFileInfo(fname).suffix() == "pcd")
+		return data->openFile(fname);
+
+	// Same loader as the gui, run to the end on this thread
+	ParallelCoordsLoader loader(fname);
+	connect(&loader, SIGNAL(header(QStringList, QVector<int>)), 
+			this, SLOT(loadHeader(QStringList, QVector<int>)), 
+			Qt::DirectConnection);
+	connect(&loader, SIGNAL(categoriesAdded(int, QStringList)), 
+			this, SLOT(loadCategories(int, QStringList)), 
+			Qt::DirectConnection);
+	connect(&loader, SIGNAL(batchReady(ParallelCoordsRowBatch)),
+			this, SLOT(loadBatch(ParallelCoordsRowBatch)), 
+			Qt::DirectConnection);
+	loader.load();
+	return data->axis_count() > 0;
+}
+
+void ParallelCoordsTileServer::loadHeader(QStringList axisNames,
+	QVector<int> axisTypes)
+{
+	data->setAxisCount(axisNames.count());
+	for(int i=0; i<axisNames.count(); i++) {
+		data->setAxisType(i, static_cast<QParallelCoordsData::AxisType>(axisTypes[i]));
+		data->setAxisName(i, axisNames[i]);
+	}
+}
+
+void ParallelCoordsTileServer::loadCategories(int axis, QStringList names)
+{
+	data->addCategories(axis, names);
+}
+
+void ParallelCoordsTileServer::loadBatch(ParallelCoordsRowBatch rows)
+{
+	data->addPoints(rows);
+}
+
+bool ParallelCoordsTileServer::listen(QString name)
+{
+	// a server that died leaves its socket file behind
+	QLocalServer::removeServer(name);
+	return server->listen(name);
+}
+
+void ParallelCoordsTileServer::newConnection()
+{
+	while(server->hasPendingConnections()) {
+		QLocalSocket *socket = server->nextPendingConnection();
+		connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+		connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+	}
+}
+
+void ParallelCoordsTileServer::readRequests()
+{
+	QLocalSocket *socket = static_cast<QLocalSocket*>(sender());
+	while(socket->canReadLine()) {
+		QString request = QString::fromUtf8(socket->readLine()).trimmed();
+		reply *r = new reply;
+		r->socket = socket;
+		r->bytes = answer(request, r);
+		r->ready = !r->bytes.isEmpty();
+		replies.push_back(r);
+	}
+	sendReplies();
+	renderNext();
+}
+
+void ParallelCoordsTileServer::sendReplies()
+{
+	// a client that went away meanwhile just gets nothing
+	while(!replies.isEmpty() && replies.front()->ready) {
+		reply *r = replies.takeFirst();
+		if(r->socket)
+			r->socket->write(r->bytes);
+		delete r;
+	}
+}
+
+void ParallelCoordsTileServer::renderNext()
+{
+	if(rendering.answer || tileQueue.isEmpty())
+		return;
+
+	// The view is looked up only now, views may have been dropped
+	// while the request was waiting
+	tileRequest t = tileQueue.takeFirst();
+	viewState *v = view(t.key, t.boxWidth, t.spacing, t.order, t.scale, t.size);
+	const int tileWidth = v->canvasSize.width() * t.scale.first;
+	const int tileHeight = v->canvasSize.height() * t.scale.second;
+	if(tileWidth <= 0 || tileHeight <= 0 ||
+	   t.column * tileWidth >= v->canvasSize.width() ||
+	   t.row * tileHeight >= v->canvasSize.height()) {
+		t.answer->bytes = "ERR tile out of range\n";
+		t.answer->ready = true;
+		sendReplies();
+		QMetaObject::invokeMethod(this, "renderNext", Qt::QueuedConnection);
+		return;
+	}
+
+	rendering = t;
+	renderingManager = v->renderManager;
+	renderingRect = QRect(t.column * tileWidth, t.row * tileHeight,
+		tileWidth, tileHeight);
+	QMetaObject::invokeMethod(renderingManager, "getTile",
+		Qt::QueuedConnection, Q_ARG(QRect, renderingRect));
+}
+
+void ParallelCoordsTileServer::tileReady(QRect r, QImage *img)
+{
+	// Managers also send tiles nobody asked for, after verifying
+	// tiles from the disk cache
+	if(rendering.answer == nullptr || sender() != renderingManager ||
+	   r != renderingRect) {
+		delete img;
+		return;
+	}
+
+	QByteArray png;
+	{
+		QBuffer buffer(&png);
+		buffer.open(QIODevice::WriteOnly);
+		img->save(&buffer, "PNG");
+	}
+	delete img;
+	rendering.answer->bytes = "OK " + QByteArray::number(png.size()) + "\n" + png;
+	rendering.answer->ready = true;
+	rendering.answer = nullptr;
+	renderingManager = nullptr;
+	sendReplies();
+	renderNext();
+}
+
+ParallelCoordsTileServer::viewState* ParallelCoordsTileServer::view(
+	QString key, int boxWidth, int spacing, QVector<int> const& order,
+	QPair<qreal, qreal> scale, QSize size)
+{
+	viewOrder.removeOne(key);
+	viewOrder.push_back(key);
+	if(views.contains(key))
+		return views[key];
+
+	// Laid out the way the widget does it
+	viewState *v = new viewState;
+	QVector<axis_view_data> *axes = new QVector<axis_view_data>;
+	const qreal pitch = spacing + boxWidth;
+	for(int i=0; i<order.count(); i++) {
+		axis_view_data a = {order[i], i * pitch + boxWidth/2.0};
+		axes->push_back(a);
+	}
+	int yExtent = data->getMaxValue() > 0 ? data->getMaxValue() : 0;
+	v->canvasSize = QSize(order.count() * boxWidth + 
+		(order.count()-1) * spacing, yExtent);
+	// the density a widget of this size has at these scale factors
+	QPair<qreal, qreal> density(1, 1);
+	if(!v->canvasSize.isEmpty()) {
+		density.first = size.width() / (v->canvasSize.width() * scale.first);
+		density.second = size.height() / (v->canvasSize.height() * scale.second);
+	}
+	v->renderManager = new ParallelCoordsRenderManager(v->canvasSize,
+		density, size, ParallelCoordsLayout(axes), data);
+	v->renderManager->moveToThread(renderThread);
+	connect(v->renderManager, SIGNAL(tileGenerated(QRect, QImage*)),
+			this, SLOT(tileReady(QRect, QImage*)));
+	views.insert(key, v);
+
+	// The view just asked for is the most recent one, so the one
+	// rendering is never dropped
+	while(viewOrder.count() > maxViews) {
+		viewState *old = views.take(viewOrder.takeFirst());
+		old->renderManager->deleteLater();
+		delete old;
+	}
+	return v;
+}
+
+QByteArray ParallelCoordsTileServer::answer(QString request, reply *r)
+{
+	QStringList args = request.split(" ", QString::SkipEmptyParts);
+	if(args.isEmpty())
+		return "ERR empty request\n";
+
+	if(args[0] == "INFO") {
+		QStringList names;
+		for(int i=0; i<data->axis_count(); i++)
+			names << data->getAxisName(i);
+		QByteArray text = QString("axes=%1\nrows=%2\n")
+			.arg(names.join(",")).arg(data->length()).toUtf8();
+		return "OK " + QByteArray::number(text.size()) + "\n" + text;
+	}
+
+	if(args[0] != "TILE" || args.count() < 9 || args.count() > 10)
+		return "ERR bad request\n";
+
+	bool ok = true, k;
+	int boxWidth = args[1].toInt(&k); ok &= k && boxWidth > 0;
+	int spacing = args[2].toInt(&k); ok &= k && spacing >= 0;
+	qreal scaleX = args[3].toDouble(&k); ok &= k && scaleX > 0 && scaleX <= 1;
+	qreal scaleY = args[4].toDouble(&k); ok &= k && scaleY > 0 && scaleY <= 1;
+	int width = args[5].toInt(&k); ok &= k && width > 0 && width <= 8192;
+	int height = args[6].toInt(&k); ok &= k && height > 0 && height <= 8192;
+	int column = args[7].toInt(&k); ok &= k && column >= 0;
+	int row = args[8].toInt(&k); ok &= k && row >= 0;
+	ok &= static_cast<qint64>(width) * height <= maxTilePixels;
+	if(!ok)
+		return "ERR bad arguments\n";
+
+	// Every queued tile may take a full frame and its png once it is
+	// rendered, a client only gets so many in flight
+	int socketTiles = rendering.answer && rendering.answer->socket == r->socket;
+	foreach(tileRequest const& t, tileQueue) {
+		if(t.answer->socket == r->socket)
+			socketTiles++;
+	}
+	if(socketTiles >= maxSocketTiles || tileQueue.count() >= maxQueuedTiles)
+		return "ERR busy\n";
+
+	QVector<int> order;
+	if(args.count() == 10) {
+		QVector<bool> seen(data->axis_count(), false);
+		foreach(QString idx, args[9].split(",")) {
+			int a = idx.toInt(&k);
+			if(!k || a < 0 || a >= data->axis_count() || seen[a])
+				return "ERR bad axis order\n";
+			seen[a] = true;
+			order.push_back(a);
+		}
+	}
+	else {
+		for(int i=0; i<data->axis_count(); i++)
+			order.push_back(i);
+	}
+	if(order.count() < 2 || data->length() == 0)
+		return "ERR nothing to draw\n";
+
+	// The key is everything but the tile position
+	QStringList state = args.mid(1, 6);
+	state << (args.count() == 10 ? args[9] : QString("*"));
+	tileRequest t = {r, state.join(" "), boxWidth, spacing, order,
+		qMakePair(scaleX, scaleY), QSize(width, height), column, row};
+	tileQueue.push_back(t);
+	return QByteArray();
+}
@@ -0,0 +1,99 @@
+#ifndef __PARALLELCOORDSTILESERVER_H__
+#define __PARALLELCOORDSTILESERVER_H__
+
+#include "ParallelCoordinates.h"
+#include "QParallelCoordsData.h"
+#include "ParallelCoordsViewPrivate.h"
+#include "ParallelCoordsRenderManager.h"
+#include "ParallelCoordsRenderThread.h"
+#include "ParallelCoordsLoader.h"
+#include <QtNetwork>
+
+// Serves rendered tiles of one loaded data set over a local socket,
+// much like a map tile server. A request is one line
+//
+//   TILE <box width> <spacing> <scale x> <scale y> <width> <height>
+//        <column> <row> [axis order]
+//
+// where the axis order is a comma separated list of axis indices,
+// all axes in file order when left out. Tile (column, row) covers
+// the canvas rect a view of that size shows when scrolled to it. The
+// answer is "OK <bytes>" and a png image, or "ERR <reason>". "INFO"
+// answers with the axis names and row count as text. A client with
+// too many tiles in flight is answered "ERR busy".
+//
+// Clients asking for the same view state share its render manager
+// and with it the tile cache. Tiles are rendered on a render thread
+// one at a time, answers go out in the order the requests came in.
+class ParallelCoordsTileServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	ParallelCoordsTileServer(QObject *parent = 0);
+	~ParallelCoordsTileServer();
+
+	// csv files are parsed before this returns, column files are
+	// opened out of core
+	bool load(QString fname);
+	bool listen(QString name);
+
+private slots:
+	void newConnection();
+	void readRequests();
+	void tileReady(QRect r, QImage *img);
+	void renderNext();
+	void loadHeader(QStringList axisNames, QVector<int> axisTypes);
+	void loadCategories(int axis, QStringList names);
+	void loadBatch(ParallelCoordsRowBatch rows);
+
+private:
+	struct viewState {
+		QSize canvasSize;
+		ParallelCoordsRenderManager *renderManager;
+	};
+
+	// An answer, sent once it and all before it are ready
+	struct reply {
+		QPointer<QLocalSocket> socket;
+		QByteArray bytes;
+		bool ready;
+	};
+
+	// A parsed TILE request waiting for its turn
+	struct tileRequest {
+		reply *answer;
+		QString key;
+		int boxWidth;
+		int spacing;
+		QVector<int> order;
+		QPair<qreal, qreal> scale;
+		QSize size;
+		int column;
+		int row;
+	};
+
+	QParallelCoordsData *data;
+	QLocalServer *server;
+	ParallelCoordsRenderThread *renderThread;
+	QHash<QString, viewState*> views;
+	QList<QString> viewOrder;		// least recently used first
+	int maxViews;
+	int maxSocketTiles;			// queued or rendering, per client
+	int maxQueuedTiles;			// of all clients
+	qint64 maxTilePixels;
+	QList<reply*> replies;			// in request order
+	QList<tileRequest> tileQueue;
+	tileRequest rendering;			// answer is nullptr when idle
+	ParallelCoordsRenderManager *renderingManager;
+	QRect renderingRect;
+
+	// The answer if known right away, otherwise the request is queued
+	// to fill in r and nothing is returned
+	QByteArray answer(QString request, reply *r);
+	void sendReplies();
+	viewState* view(QString key, int boxWidth, int spacing,
+		QVector<int> const& order, QPair<qreal, qreal> scale, QSize size);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "ParallelCoordinates.h"
+#include "ParallelCoordsTrace.h"
+
+ParallelCoordsTrace::ParallelCoordsTrace()
+: recording(false)
+{
+}
+
+void ParallelCoordsTrace::start(QString dataset)
+{
+	datasetName = dataset;
+	eventList.clear();
+	clock.start();
+	recording = true;
+}
+
+void ParallelCoordsTrace::stop()
+{
+	recording = false;
+}
+
+bool ParallelCoordsTrace::isRecording() const
+{
+	return recording;
+}
+
+void ParallelCoordsTrace::record(QString kind, QList<qreal> const& args)
+{
+	if(!recording) return;
+
+	event e;
+	e.msecs = clock.elapsed();
+	e.kind = kind;
+	e.args = args;
+	eventList.push_back(e);
+}
+
+bool ParallelCoordsTrace::save(QString fname) const
+{
+	QFile f(fname);
+	if(!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+		return false;
+
+	// axis positions and scales have to come back exactly
+	QTextStream out(&f);
+	out << qSetRealNumberPrecision(17);
+	out << "dataset " << datasetName << "\n";
+	foreach(event e, eventList) {
+		out << e.msecs << " " << e.kind;
+		foreach(qreal arg, e.args)
+			out << " " << arg;
+		out << "\n";
+	}
+	return f.error() == QFile::NoError;
+}
+
+bool ParallelCoordsTrace::load(QString fname)
+{
+	QFile f(fname);
+	if(!f.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+
+	QTextStream in(&f);
+	QString line = in.readLine();
+	if(!line.startsWith("dataset "))
+		return false;
+	datasetName = line.mid(8).trimmed();
+	eventList.clear();
+	recording = false;
+
+	// Lines that do not parse are skipped, a trace cut short by a
+	// crash still replays up to where it ends
+	while(!(line = in.readLine()).isNull()) {
+		QStringList fields = line.split(" ", QString::SkipEmptyParts);
+		if(fields.count() < 2)
+			continue;
+
+		event e;
+		bool ok;
+		e.msecs = fields[0].toLongLong(&ok);
+		if(!ok) continue;
+		e.kind = fields[1];
+		for(int i=2; ok && i<fields.count(); i++)
+			e.args.push_back(fields[i].toDouble(&ok));
+		if(ok)
+			eventList.push_back(e);
+	}
+	return true;
+}
+
+QString ParallelCoordsTrace::dataset() const
+{
+	return datasetName;
+}
+
+QList<ParallelCoordsTrace::event> const& ParallelCoordsTrace::events() const
+{
+	return eventList;
+}
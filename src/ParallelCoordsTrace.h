@@ -0,0 +1,44 @@
+#ifndef __PARALLELCOORDSTRACE_H__
+#define __PARALLELCOORDSTRACE_H__
+
+#include "ParallelCoordinates.h"
+
+// A recorded interaction session, replayed to measure frame latency.
+// Traces are text files, the data set on the first line and then one
+// event per line
+//
+//   dataset <file>
+//   <msecs> <kind> <args>
+//
+// Kinds are scroll (x y), scale (x y), spacing (w), box (w),
+// resize (w h) and move (axis index, canvas x).
+class ParallelCoordsTrace
+{
+public:
+	struct event {
+		qint64 msecs;				// since recording started
+		QString kind;
+		QList<qreal> args;
+	};
+
+	ParallelCoordsTrace();
+
+	void start(QString dataset);
+	void stop();
+	bool isRecording() const;
+	void record(QString kind, QList<qreal> const& args);
+
+	bool save(QString fname) const;
+	bool load(QString fname);
+
+	QString dataset() const;
+	QList<event> const& events() const;
+
+private:
+	QString datasetName;
+	QList<event> eventList;
+	QElapsedTimer clock;
+	bool recording;
+};
+
+#endif
@@ -3,13 +3,20 @@
 #define __PARALLELCOORDSVIEWPRIVATE__
 
 #include "ParallelCoordinates.h"
+#include "ParallelCoordsRaster.h"
+#include <vector>
 
+// Kept small as there is one per data column. All axes span the full
+// canvas height so only the horizontal position is stored.
 struct axis_view_data {
 	int index;
-	QRectF bounding_box;
-	QPointF pos;
+	qreal x;
 };
 
+// Axes in order of their x, as handed to a renderer. Never changed
+// once built, a new layout is published instead.
+typedef QSharedPointer<QVector<axis_view_data> const> ParallelCoordsLayout;
+
 struct renderData {
 	int index;
 	qreal data_min;
@@ -19,4 +26,38 @@ struct renderData {
 	qreal axis_height;
 };
 
+// Projected rows of one render chunk. The x of a point is the x of
+// its axis so only y is kept, axis major: the y of row i on the j-th
+// relevant axis is ys[j*rowCnt + i]. Missing values are NaN.
+// drawn has a bit per row and axis in the same order, (rowCnt+63)/64
+// words per axis, set where the row has a value and is shown by the
+// filter of the data and the mask of the view. weights holds how many input rows each row stands for, nullptr when
+// every row counts once.
+struct renderChunk {
+	int firstRow;
+	int rowCnt;
+	int axisCnt;
+	qreal const *ys;
+	quint64 const *drawn;
+	quint32 const *weights;
+};
+
+// Buffers of one render, reused from chunk to chunk and freed with the
+// render. Each of the two bands drawn at once clips into its own.
+struct bandScratch {
+	std::vector<QLineF> segments;
+	std::vector<int> segmentRows;
+	std::vector<ParallelCoordsRaster::pixelSegment> pixelSegments;
+};
+
+struct renderScratch {
+	QVector<QVector<qreal>> columnBuffers;
+	QVector<qreal const*> columns;
+	std::vector<qreal> ys;
+	std::vector<quint64> drawn;
+	QVector<quint64> validity;
+	QVector<quint32> weights;
+	bandScratch bands[2];
+};
+
 #endif
\ No newline at end of file
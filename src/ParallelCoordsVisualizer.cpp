@@ -3,52 +3,247 @@
 #include "ParallelCoordsVisualizer.h"
 #include "QParallelCoordsWidget.h"
 #include "QParallelCoordsData.h"
-#include <algorithm>
+#include "ParallelCoordsTileServer.h"
 
 ParallelCoordsVisualizer::ParallelCoordsVisualizer(QWidget *parent)
 : QWidget(parent)
 {
 	setWindowTitle("Parallel Coordinates Visualizer");
+	loader = nullptr;
+	loaderThread = nullptr;
+	trace = new ParallelCoordsTrace();
+	replay = nullptr;
+	clustering = nullptr;
+	clusteredVersion = 0;
 	init_components();
 }
 
 ParallelCoordsVisualizer::~ParallelCoordsVisualizer()
 {
-
+	if(loader) {
+		// deleted here rather than by the thread as it finishes
+		disconnect(loaderThread, SIGNAL(finished()), loader, SLOT(deleteLater()));
+		loader->cancel();
+		loaderThread->quit();
+		loaderThread->wait();
+		delete loader;
+	}
+	coord_wd->setTrace(nullptr);
+	// views of their own window go before the data they show
+	foreach(QPointer<QParallelCoordsWidget> view, extraViews) {
+		delete view;
+	}
+	delete clustering;
+	delete trace;
 }
 
 void ParallelCoordsVisualizer::loadFile()
 {
-	QString fname = QFileDialog::getOpenFileName(this, tr("Select Input file"), "", "CSV File file (*.csv)");
-	QFile inpFile(fname);
+	// one load at a time
+	if(loader) return;
 
-	if(!inpFile.exists()) return;
+	QString fname = QFileDialog::getOpenFileName(this, tr("Select Input file"), "", 
+		"CSV File file (*.csv);;Column file (*.pcd)");
+	openDataset(fname);
+}
 
-	inpFile.open(QIODevice::ReadOnly);
-	QTextStream txtStrm(&inpFile);
-	QString inp = txtStrm.readLine();
-	QStringList axisNames = inp.split(",", QString::SkipEmptyParts);
-	int axisCnt = axisNames.count();
+bool ParallelCoordsVisualizer::openDataset(QString fname)
+{
+	QFile inpFile(fname);
 
-	data->setAxisCount(axisCnt);
-	{
-		int idx = 0;
-		foreach(QString name, axisNames) {
-			data->setAxisName(idx++, name);
+	if(!inpFile.exists()) return false;
+	datasetName = QFileInfo(fname).absoluteFilePath();
+
+	// Column files are rendered out of core straight from disk
+	if(QFileInfo(fname).suffix() == "pcd") {
+		if(!data->openFile(fname)) {
+			infoLabel->setText(QString("Could not open %1").arg(fname));
+			return false;
 		}
-		inp = txtStrm.readLine();
+		return true;
 	}
 
-	QList<QVector<qreal>> pts;
-	while(!inp.isEmpty()) {
-		QVector<qreal> pt(axisCnt);
-		QStringList inpList = inp.split(",", QString::SkipEmptyParts);
-		std::transform(inpList.begin(), inpList.begin()+axisCnt, pt.begin(), [](QString s){return s.toDouble();});
-		pts.push_back(pt);
-		inp = txtStrm.readLine();
+	// Parsing happens on a worker thread, rows arrive in batches
+	// and are drawn while the rest of the file is read
+	loader = new ParallelCoordsLoader(fname);
+	loaderThread = new QThread(this);
+	loader->moveToThread(loaderThread);
+
+	connect(loaderThread, SIGNAL(started()), loader, SLOT(load()));
+	connect(loader, SIGNAL(header(QStringList, QVector<int>)), 
+			this, SLOT(loadHeader(QStringList, QVector<int>)));
+	connect(loader, SIGNAL(categoriesAdded(int, QStringList)), 
+			this, SLOT(loadCategories(int, QStringList)));
+	connect(loader, SIGNAL(batchReady(ParallelCoordsRowBatch)),
+			this, SLOT(loadBatch(ParallelCoordsRowBatch)));
+	connect(loader, SIGNAL(progress(int)), loadProgress, SLOT(setValue(int)));
+	connect(loader, SIGNAL(failed(QString)), this, SLOT(loadFailed(QString)));
+	connect(loader, SIGNAL(finished(bool, qint64)), this, SLOT(loadFinished(bool, qint64)));
+	connect(loader, SIGNAL(finished(bool, qint64)), loaderThread, SLOT(quit()));
+	connect(loaderThread, SIGNAL(finished()), loader, SLOT(deleteLater()));
+	connect(loaderThread, SIGNAL(finished()), loaderThread, SLOT(deleteLater()));
+
+	loadError.clear();
+	data->setLoading(true);
+	loadProgress->setValue(0);
+	loadProgress->show();
+	cancelLoadButton->show();
+	loaderThread->start();
+	return true;
+}
+
+void ParallelCoordsVisualizer::loadHeader(QStringList axisNames, QVector<int> axisTypes)
+{
+	data->setAxisCount(axisNames.count());
+	int idx = 0;
+	foreach(QString name, axisNames) {
+		data->setAxisType(idx, static_cast<QParallelCoordsData::AxisType>(axisTypes[idx]));
+		data->setAxisName(idx++, name);
 	}
-	data->addPoints(pts);
-	inpFile.close();
+}
+
+void ParallelCoordsVisualizer::loadCategories(int axis, QStringList names)
+{
+	data->addCategories(axis, names);
+}
+
+void ParallelCoordsVisualizer::loadBatch(ParallelCoordsRowBatch rows)
+{
+	data->addPoints(rows);
+}
+
+void ParallelCoordsVisualizer::loadFailed(QString message)
+{
+	loadError = message;
+}
+
+void ParallelCoordsVisualizer::loadFinished(bool cancelled, qint64 droppedFields)
+{
+	loader = nullptr;
+	loaderThread = nullptr;
+	data->setLoading(false);
+	loadProgress->hide();
+	cancelLoadButton->hide();
+	if(!loadError.isEmpty()) {
+		infoLabel->setText(loadError);
+		// a replay has nothing to play against
+		if(replay)
+			replayFinished(loadError);
+		return;
+	}
+	QString text = QString(cancelled ? "Load cancelled after %1 rows" : 
+		"Loaded %1 rows").arg(data->weightedLength());
+	if(data->isDeduplicated())
+		text += QString(", %1 unique").arg(data->length());
+	text += QString(", %1 MB").arg(data->columnBytes() / (1024.0 * 1024.0), 0, 'f', 1);
+	if(droppedFields > 0)
+		text += QString(", %1 fields on numeric axes were not numbers and "
+			"are missing").arg(droppedFields);
+	infoLabel->setText(text);
+	if(replay)
+		startReplay();
+}
+
+void ParallelCoordsVisualizer::toggleRecording()
+{
+	if(!trace->isRecording()) {
+		if(datasetName.isEmpty()) return;
+		trace->start(datasetName);
+		coord_wd->setTrace(trace);
+		recordButton->setText("Stop Recording");
+		return;
+	}
+
+	trace->stop();
+	coord_wd->setTrace(nullptr);
+	recordButton->setText("Record Trace");
+
+	QString fname = QFileDialog::getSaveFileName(this, tr("Save trace"), "", 
+		"Trace (*.trace)");
+	if(fname.isEmpty()) return;
+
+	if(!trace->save(fname))
+		infoLabel->setText(QString("Could not save %1").arg(fname));
+	else
+		infoLabel->setText(QString("Recorded %1 events")
+			.arg(trace->events().count()));
+}
+
+bool ParallelCoordsVisualizer::replayTrace(QString fname)
+{
+	if(!trace->load(fname)) return false;
+
+	replay = new ParallelCoordsReplay(this, trace, coord_wd);
+	connect(replay, SIGNAL(finished(QString)), 
+			this, SLOT(replayFinished(QString)));
+	if(!openDataset(trace->dataset())) return false;
+
+	// csv files start once the loader is done, see loadFinished
+	if(!loader)
+		QTimer::singleShot(0, this, SLOT(startReplay()));
+	return true;
+}
+
+void ParallelCoordsVisualizer::startReplay()
+{
+	infoLabel->setText("Replaying");
+	replay->start();
+}
+
+void ParallelCoordsVisualizer::replayFinished(QString report)
+{
+	infoLabel->setText(report);
+	QTextStream(stdout) << report << "\n";
+	qApp->quit();
+}
+
+void ParallelCoordsVisualizer::cancelLoad()
+{
+	if(loader)
+		loader->cancel();
+}
+
+void ParallelCoordsVisualizer::saveFile()
+{
+	QString fname = QFileDialog::getSaveFileName(this, tr("Save column file"), "", 
+		"Column file (*.pcd)");
+	if(fname.isEmpty()) return;
+
+	if(!data->saveFile(fname))
+		infoLabel->setText(QString("Could not save %1").arg(fname));
+}
+
+void ParallelCoordsVisualizer::exportPoster()
+{
+	if(data->axis_count() <= 0 || data->length() == 0) return;
+
+	QString fname = QFileDialog::getSaveFileName(this, tr("Export image"), "", 
+		"PNG image (*.png)");
+	if(fname.isEmpty()) return;
+
+	bool ok;
+	int width = QInputDialog::getInt(this, tr("Export image"), tr("Width"),
+		coord_wd->getCanvasSize().width(), 1, 1 << 20, 1, &ok);
+	if(!ok) return;
+	int height = QInputDialog::getInt(this, tr("Export image"), tr("Height"),
+		coord_wd->getCanvasSize().height(), 1, 1 << 20, 1, &ok);
+	if(!ok) return;
+
+	ParallelCoordsPosterExport *e = coord_wd->createPosterExport(this);
+	connect(e, SIGNAL(progress(int, int)), this, SLOT(exportProgress(int, int)));
+	connect(e, SIGNAL(finished(bool)), this, SLOT(exportFinished(bool)));
+	e->start(fname, QSize(width, height));
+}
+
+void ParallelCoordsVisualizer::exportProgress(int done, int total)
+{
+	infoLabel->setText(QString("Exporting %1/%2").arg(done).arg(total));
+}
+
+void ParallelCoordsVisualizer::exportFinished(bool ok)
+{
+	infoLabel->setText(ok ? "Export done" : "Export failed");
+	sender()->deleteLater();
 }
 
 void ParallelCoordsVisualizer::axisSelected(int idx)
@@ -60,6 +255,29 @@ void ParallelCoordsVisualizer::axisSelected(int idx)
 	infoLabel->setText(QString("Selected: %1").arg(data->getAxisName(idx)));
 }
 
+void ParallelCoordsVisualizer::rowsPicked(QVector<int> rows)
+{
+	// a miss keeps whatever the label shows
+	if(rows.isEmpty())
+		return;
+
+	// Values of the nearest row, a count for the rest
+	const int maxShownValues = 8;
+	QStringList values;
+	for(int i=0; i<data->axis_count() && i<maxShownValues; i++) {
+		values << QString("%1=%2").arg(data->getAxisName(i))
+								  .arg(data->valueText(rows.front(), i));
+	}
+	if(data->axis_count() > maxShownValues)
+		values << "...";
+
+	QString text = QString("Row %1: %2").arg(rows.front())
+										.arg(values.join(", "));
+	if(rows.count() > 1)
+		text += QString(" (+%1 more)").arg(rows.count()-1);
+	infoLabel->setText(text);
+}
+
 void ParallelCoordsVisualizer::setCurveMode(int state)
 {
 	if(state == 0) {
@@ -70,6 +288,122 @@ void ParallelCoordsVisualizer::setCurveMode(int state)
 	}
 }
 
+void ParallelCoordsVisualizer::setCompression(int state)
+{
+	data->setCompression(state != 0);
+}
+
+void ParallelCoordsVisualizer::setDeduplication(int state)
+{
+	data->setDeduplication(state != 0);
+}
+
+void ParallelCoordsVisualizer::summarize()
+{
+	if(data->axis_count() <= 0 || data->length() == 0) return;
+
+	// Clusters of the data as it is now are kept for going back to
+	// after a drill down, the same seed gives the same clusters
+	quint64 version = data->snapshot()->version();
+	if(!clustering || clusteredVersion != version) {
+		delete clustering;
+		clustering = new ParallelCoordsClustering(this, data, 12, 1);
+		clusteredVersion = version;
+		connect(clustering, SIGNAL(refined(ParallelCoordsClusterSummary)),
+				coord_wd, SLOT(setClusterSummary(ParallelCoordsClusterSummary)));
+		connect(clustering, SIGNAL(refined(ParallelCoordsClusterSummary)),
+				this, SLOT(clustersRefined(ParallelCoordsClusterSummary)));
+		connect(clustering, SIGNAL(finished(bool)),
+				this, SLOT(clusteringFinished(bool)));
+		clustering->start();
+	}
+	coord_wd->setSummaryMode(true);
+}
+
+void ParallelCoordsVisualizer::showAllRows()
+{
+	if(clustering)
+		clustering->cancel();
+	coord_wd->showAllRows();
+}
+
+void ParallelCoordsVisualizer::clustersRefined(
+	ParallelCoordsClusterSummary summary)
+{
+	infoLabel->setText(QString("Clustering, %1 of %2 rows seen")
+		.arg(summary.rowsSeen).arg(data->length()));
+}
+
+void ParallelCoordsVisualizer::clusteringFinished(bool ok)
+{
+	if(!ok) {
+		// cancelled clusters are not worth going back to
+		if(sender() == clustering) {
+			clustering->deleteLater();
+			clustering = nullptr;
+		}
+		return;
+	}
+	infoLabel->setText("Click a cluster to show its rows");
+}
+
+void ParallelCoordsVisualizer::clusterOpened(int cluster, int rows)
+{
+	infoLabel->setText(QString("Cluster %1, %2 rows").arg(cluster+1).arg(rows));
+}
+
+void ParallelCoordsVisualizer::applyFilter()
+{
+	if(!data->setFilter(filterEdit->text())) {
+		infoLabel->setText(data->filterError());
+		return;
+	}
+	// the rows are counted once they are selected, see filterApplied
+	if(!data->filterText().isEmpty())
+		infoLabel->setText("Filtering...");
+}
+
+void ParallelCoordsVisualizer::filterApplied()
+{
+	ParallelCoordsRowMask selection = data->selection();
+	if(!selection) {
+		infoLabel->setText("Showing every row");
+		return;
+	}
+	infoLabel->setText(QString("%1 of %2 rows match")
+		.arg(selection->rowCount()).arg(data->length()));
+}
+
+void ParallelCoordsVisualizer::attachSharedMemory()
+{
+	if(loader || data->axis_count() > 0) return;
+
+	bool ok;
+	QString name = QInputDialog::getText(this, tr("Attach shared memory"),
+		tr("Segment name"), QLineEdit::Normal, "", &ok);
+	if(!ok || name.isEmpty()) return;
+
+	if(!data->openSharedMemory(name))
+		infoLabel->setText(QString("Could not attach to %1").arg(name));
+}
+
+void ParallelCoordsVisualizer::newView()
+{
+	// A window of its own on the same data, it shares the render
+	// thread and tiles with the main view and brushes along with it
+	QParallelCoordsWidget *view = new QParallelCoordsWidget(data);
+	view->setAttribute(Qt::WA_DeleteOnClose);
+	view->setInterAxisWidth(coord_wd->getInterAxisWidth());
+	view->setAxisBoxWidth(coord_wd->getAxisBoxWidth());
+	view->setMemoryLimit(memoryLimitBox->value());
+	connect(data, SIGNAL(dataChanged(bool)), view, SLOT(updateView(bool)));
+	connect(memoryLimitBox, SIGNAL(valueChanged(int)), view, SLOT(setMemoryLimit(int)));
+	extraViews.push_back(view);
+	view->resize(coord_wd->size());
+	view->show();
+	view->updateView(true);
+}
+
 void ParallelCoordsVisualizer::init_components()
 {
 	data = new QParallelCoordsData(this);
@@ -81,6 +415,51 @@ void ParallelCoordsVisualizer::init_components()
 	QWidget *wd = new QPushButton("Load File");
 	layout->addWidget(wd, 0, 0);
 	connect(wd, SIGNAL(clicked()), this, SLOT(loadFile()));
+
+	wd = new QPushButton("Save Columns");
+	layout->addWidget(wd, 2, 0);
+	connect(wd, SIGNAL(clicked()), this, SLOT(saveFile()));
+
+	wd = new QPushButton("Export Image");
+	layout->addWidget(wd, 3, 0);
+	connect(wd, SIGNAL(clicked()), this, SLOT(exportPoster()));
+
+	wd = new QPushButton("Attach Shared Memory");
+	layout->addWidget(wd, 7, 0);
+	connect(wd, SIGNAL(clicked()), this, SLOT(attachSharedMemory()));
+
+	wd = new QPushButton("New View");
+	layout->addWidget(wd, 6, 0);
+	connect(wd, SIGNAL(clicked()), this, SLOT(newView()));
+
+	recordButton = new QPushButton("Record Trace");
+	layout->addWidget(recordButton, 8, 0);
+	connect(recordButton, SIGNAL(clicked()), this, SLOT(toggleRecording()));
+
+	wd = new QPushButton("Summarize");
+	layout->addWidget(wd, 9, 0);
+	connect(wd, SIGNAL(clicked()), this, SLOT(summarize()));
+
+	wd = new QPushButton("All Rows");
+	layout->addWidget(wd, 10, 0);
+	connect(wd, SIGNAL(clicked()), this, SLOT(showAllRows()));
+
+	// applied on return, an empty filter shows every row
+	filterEdit = new QLineEdit();
+	filterEdit->setPlaceholderText("Filter, e.g. latency > 200 && region == 3");
+	layout->addWidget(filterEdit, 11, 0);
+	connect(filterEdit, SIGNAL(returnPressed()), this, SLOT(applyFilter()));
+	connect(data, SIGNAL(filterChanged()), this, SLOT(filterApplied()));
+
+	loadProgress = new QProgressBar();
+	loadProgress->setRange(0, 100);
+	loadProgress->hide();
+	layout->addWidget(loadProgress, 4, 0);
+
+	cancelLoadButton = new QPushButton("Cancel Load");
+	cancelLoadButton->hide();
+	layout->addWidget(cancelLoadButton, 5, 0);
+	connect(cancelLoadButton, SIGNAL(clicked()), this, SLOT(cancelLoad()));
 	
 	wd = new QLabel("Inter-Axis span");
 	layout->addWidget(wd, 0, 1);
@@ -130,23 +509,78 @@ void ParallelCoordsVisualizer::init_components()
 	layout->addWidget(wd, 0, 9);
 	connect(wd, SIGNAL(clicked()), coord_wd, SLOT(updateLayout()));
 
-	wd = new QCheckBox("Curve axis");
+	wd = new QPushButton("Reorder");
 	layout->addWidget(wd, 0, 10);
+	connect(wd, SIGNAL(clicked()), coord_wd, SLOT(reorderAxes()));
+
+	wd = new QCheckBox("Curve axis");
+	layout->addWidget(wd, 0, 11);
 	connect(wd, SIGNAL(stateChanged(int)), this, SLOT(setCurveMode(int)));
 
+	wd = new QCheckBox("Compress columns");
+	layout->addWidget(wd, 0, 12);
+	connect(wd, SIGNAL(stateChanged(int)), this, SLOT(setCompression(int)));
+
+	// only before a file is loaded
+	wd = new QCheckBox("Collapse duplicates");
+	layout->addWidget(wd, 0, 13);
+	connect(wd, SIGNAL(stateChanged(int)), this, SLOT(setDeduplication(int)));
+
+	wd = new QLabel("Render memory MB");
+	layout->addWidget(wd, 0, 14);
+
+	memoryLimitBox = new QSpinBox();
+	layout->addWidget(memoryLimitBox, 0, 15);
+	memoryLimitBox->setRange(16, 16384);
+	memoryLimitBox->setValue(256);
+	coord_wd->setMemoryLimit(memoryLimitBox->value());
+	connect(memoryLimitBox, SIGNAL(valueChanged(int)), coord_wd, SLOT(setMemoryLimit(int)));
+
 	infoLabel = new QLabel("Select an axis to view the information on this bar");
 	layout->addWidget(infoLabel, 1, 0);
 	connect(coord_wd, SIGNAL(axisSelected(int)), this, SLOT(axisSelected(int)));
+	connect(coord_wd, SIGNAL(rowsPicked(QVector<int>)),
+			this, SLOT(rowsPicked(QVector<int>)));
+	connect(coord_wd, SIGNAL(clusterOpened(int, int)),
+			this, SLOT(clusterOpened(int, int)));
 
 	layout->addWidget(coord_wd, 1, 1, 1, -1);
 }
 
 int main(int argc, char** argv)
 {
+	// --serve <file> [name] runs headless as a tile server
+	QStringList args;
+	for(int i=1; i<argc; i++)
+		args << QString::fromLocal8Bit(argv[i]);
+	if(args.count() >= 2 && args[0] == "--serve") {
+		QApplication app(argc, argv, false);
+		QString name = args.count() > 2 ? args[2] : "parallel-coords";
+		ParallelCoordsTileServer server;
+		if(!server.load(args[1])) {
+			qWarning("Could not load %s", qPrintable(args[1]));
+			return 1;
+		}
+		if(!server.listen(name)) {
+			qWarning("Could not listen on %s", qPrintable(name));
+			return 1;
+		}
+		return app.exec();
+	}
+
 	QApplication app(argc, argv);
 
 	ParallelCoordsVisualizer *wnd = new ParallelCoordsVisualizer(0);
 	wnd->show();
 
+	// --replay <trace> plays a recorded session back and prints
+	// the frame latencies
+	if(args.count() >= 2 && args[0] == "--replay") {
+		if(!wnd->replayTrace(args[1])) {
+			qWarning("Could not replay %s", qPrintable(args[1]));
+			return 1;
+		}
+	}
+
 	return app.exec();
 }
\ No newline at end of file
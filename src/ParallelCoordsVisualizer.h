@@ -5,6 +5,10 @@
 #include "ParallelCoordinates.h"
 #include "QParallelCoordsData.h"
 #include "QParallelCoordsWidget.h"
+#include "ParallelCoordsLoader.h"
+#include "ParallelCoordsTrace.h"
+#include "ParallelCoordsReplay.h"
+#include "ParallelCoordsClustering.h"
 #include <QMainWindow>
 
 class ParallelCoordsVisualizer : public QWidget
@@ -15,16 +19,60 @@ public:
 	ParallelCoordsVisualizer(QWidget *parent);
 	~ParallelCoordsVisualizer();
 
+	// Loads the data set of a trace and plays the trace back against
+	// the view, the report is printed and the application quits
+	bool replayTrace(QString fname);
+
 private:
 	void init_components();
+	bool openDataset(QString fname);
 	QParallelCoordsData *data;
 	QLabel *infoLabel;
 	QParallelCoordsWidget *coord_wd;
+	QProgressBar *loadProgress;
+	QPushButton *cancelLoadButton;
+	ParallelCoordsLoader *loader;
+	QThread *loaderThread;
+	QString datasetName;
+	QString loadError;
+	ParallelCoordsTrace *trace;
+	QPushButton *recordButton;
+	QLineEdit *filterEdit;
+	QSpinBox *memoryLimitBox;
+	QList<QPointer<QParallelCoordsWidget>> extraViews;	// of New View
+	ParallelCoordsReplay *replay;
+	ParallelCoordsClustering *clustering;
+	quint64 clusteredVersion;	// of the data the clusters were fitted to
 
 private slots:
 	void loadFile();
+	void loadHeader(QStringList axisNames, QVector<int> axisTypes);
+	void loadCategories(int axis, QStringList names);
+	void loadBatch(ParallelCoordsRowBatch rows);
+	void loadFailed(QString message);
+	void loadFinished(bool cancelled, qint64 droppedFields);
+	void cancelLoad();
+	void saveFile();
+	void exportPoster();
+	void exportProgress(int done, int total);
+	void exportFinished(bool ok);
 	void axisSelected(int idx);
+	void rowsPicked(QVector<int> rows);
 	void setCurveMode(int state);
+	void setCompression(int state);
+	void setDeduplication(int state);
+	void newView();
+	void attachSharedMemory();
+	void toggleRecording();
+	void startReplay();
+	void replayFinished(QString report);
+	void summarize();
+	void showAllRows();
+	void clustersRefined(ParallelCoordsClusterSummary summary);
+	void clusteringFinished(bool ok);
+	void clusterOpened(int cluster, int rows);
+	void applyFilter();
+	void filterApplied();
 };
 
 #endif
\ No newline at end of file
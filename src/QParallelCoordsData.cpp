@@ -1,12 +1,52 @@
 
 #include "ParallelCoordinates.h"
 #include "QParallelCoordsData.h"
+#include "ParallelCoordsShmLayout.h"
+#include "ParallelCoordsFilter.h"
+#include <limits>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
-QParallelCoordsData::QParallelCoordsData(QObject *parent, const int axisCnt_) 
-: QObject(parent), axis_cnt(-1), bulkUpdate(false)
+QParallelCoordsData::QParallelCoordsData(QObject *parent, const int axisCnt_)
+: QObject(parent), axis_cnt(-1), row_cnt(0),
+  maxValue(-std::numeric_limits<qreal>::max()), loading(false),
+  compression(false), compressedSegments(0), compressingSegments(0),
+  dedup(false), weighted_cnt(0),
+  filter(nullptr), selectedRows(0), filterGeneration(0),
+  selectingRows(0), selectingGeneration(0),
+  columnFile(nullptr), columnFileOffset(0),
+  contentHasher(QCryptographicHash::Sha1),
+  shmBase(nullptr), shmSize(0), shmColumns(nullptr), shmCapacity(0),
+  shmPoll(nullptr)
 {
+	selectWatcher = new QFutureWatcher<ParallelCoordsRowMask>(this);
+	connect(selectWatcher, SIGNAL(finished()), this, SLOT(selectionReady()));
+	compressWatcher = new QFutureWatcher<compressJob>(this);
+	connect(compressWatcher, SIGNAL(finished()), this, SLOT(segmentsCompressed()));
 	setAxisCount(axisCnt_);
+	publish();
+}
+
+QParallelCoordsData::~QParallelCoordsData()
+{
+	// the selection under way may read the columns through this
+	selectWatcher->waitForFinished();
+	compressWatcher->waitForFinished();
+	delete filter;
+#ifdef Q_OS_UNIX
+	if(shmBase)
+		munmap(shmBase, shmSize);
+#endif
+}
+
+bool QParallelCoordsData::externalColumns() const
+{
+	return columnFile != nullptr || shmColumns != nullptr;
 }
 
 int QParallelCoordsData::axis_count() const
@@ -18,61 +58,832 @@ void QParallelCoordsData::setAxisCount(int cnt)
 {
 	if(axis_cnt == -1) {
 		axis_cnt = cnt;
-		for(int i=0; i<axis_cnt; i++)
-			axisData.push_back(qMakePair(QString(), qMakePair(std::numeric_limits<qreal>::max(),std::numeric_limits<qreal>::min())));
+		if(axis_cnt < 0)
+			return;
+		segments.resize(axis_cnt);
+		axisTypes.fill(Numeric, axis_cnt);
+		categories.resize(axis_cnt);
+		axisNames.resize(axis_cnt);
+		axisMin.fill(std::numeric_limits<qreal>::max(), axis_cnt);
+		axisMax.fill(-std::numeric_limits<qreal>::max(), axis_cnt);
+		publish();
+	}
+}
+
+void QParallelCoordsData::publish()
+{
+	ParallelCoordsDataSnapshot *s = new ParallelCoordsDataSnapshot();
+	s->rowCnt = row_cnt;
+	s->weightedCnt = weightedLength();
+	s->weighted = dedup;
+	s->weights = weights;
+	s->axisCnt = axis_cnt;
+	s->axisMin = axisMin;
+	s->axisMax = axisMax;
+	s->maxValue = maxValue;
+	s->loading = loading;
+	s->outOfCore = columnFile != nullptr;
+	s->external = externalColumns() ? this : nullptr;
+	s->hash = contentHash();
+
+	// A segment still filling gets a copy of its own. The copy shares
+	// the buffers, the next row written detaches the validity words,
+	// which hold bits of published rows next to the new ones. Values
+	// and codes go in place, no snapshot reads past its length.
+	const bool partial = (row_cnt & (ParallelCoordsDataSnapshot::segmentRows - 1)) != 0;
+	for(int i=0; i<qMax(axis_cnt, 0); i++) {
+		s->categorical.push_back(axisTypes[i] == Categorical);
+		QVector<QSharedPointer<ParallelCoordsDataSnapshot::segment const>> seg;
+		seg.reserve(segments[i].count());
+		foreach(segmentPointer const& p, segments[i]) {
+			seg.push_back(p);
+		}
+		if(partial && !seg.isEmpty())
+			seg.last() = QSharedPointer<ParallelCoordsDataSnapshot::segment const>(
+				new ParallelCoordsDataSnapshot::segment(*segments[i].last()));
+		s->segments.push_back(seg);
 	}
+
+	s->selected = selected;
+
+	// only this thread publishes, the next version is known ahead
+	s->ver = published.version() + 1;
+	published.publish(ParallelCoordsDataSnapshot::pointer(s));
+	updateSelection();
+}
+
+ParallelCoordsDataSnapshot::pointer QParallelCoordsData::snapshot() const
+{
+	return published.load();
 }
 
 void QParallelCoordsData::setRange(int axis_idx, QPair<qreal, qreal> range)
 {
-	axisData[axis_idx].second = range;
+	axisMin[axis_idx] = range.first;
+	axisMax[axis_idx] = range.second;
+	maxValue = qMax(maxValue, range.second);
+	publish();
 }
 
 void QParallelCoordsData::addPoint(QVector<qreal> point)
+{
+	if(point.count() != axis_cnt || externalColumns())
+		return;
+
+	appendPoint(point);
+	compressSegments();
+	publish();
+	emit dataChanged(true);
+}
+
+void QParallelCoordsData::appendPoint(QVector<qreal> const& point)
 {
 	if(point.count() != axis_cnt)
 		return;
+	QByteArray bytes = QByteArray::fromRawData(
+		reinterpret_cast<char const*>(point.constData()),
+		point.count() * sizeof(qreal));
+	contentHasher.addData(bytes);
+
+	// A row read before only counts once more. Weights of published
+	// rows are shared with the snapshots, changing one copies the
+	// weights of its segment first.
+	uint key = 0;
+	if(dedup) {
+		key = qHash(bytes);
+		QMultiHash<uint, int>::const_iterator it = rowIndex.constFind(key);
+		for(; it != rowIndex.constEnd() && it.key() == key; ++it) {
+			const int row = it.value();
+			if(!sameRow(row, point))
+				continue;
+			quint32 *w = weights[row >> ParallelCoordsDataSnapshot::segmentShift].data() +
+				(row & (ParallelCoordsDataSnapshot::segmentRows - 1));
+			if(*w < std::numeric_limits<quint32>::max())
+				(*w)++;
+			weighted_cnt++;
+			return;
+		}
+	}
 
+	// Rows only ever go behind the published ones, snapshots never
+	// read past their own length. A new segment is started once the
+	// last one is full, the old ones stay where they are.
+	const int offset = row_cnt & (ParallelCoordsDataSnapshot::segmentRows - 1);
+	const quint64 bit = Q_UINT64_C(1) << (offset & 63);
+	if(dedup) {
+		if(offset == 0) {
+			weights.push_back(QVector<quint32>(
+				ParallelCoordsDataSnapshot::segmentRows, 0));
+		}
+		weights.last().data()[offset] = 1;
+		rowIndex.insert(key, row_cnt);
+		weighted_cnt++;
+	}
 	for(int i=0; i<point.count(); i++) {
-		axisData[i].second.first = axisData[i].second.first > point[i] ? point[i] : axisData[i].second.first;
-		axisData[i].second.second = axisData[i].second.second < point[i] ? point[i] : axisData[i].second.second;
+		if(offset == 0) {
+			segmentPointer seg(new ParallelCoordsDataSnapshot::segment);
+			if(axisTypes[i] == Categorical)
+				seg->codes.resize(ParallelCoordsDataSnapshot::segmentRows);
+			else
+				seg->values.resize(ParallelCoordsDataSnapshot::segmentRows);
+			seg->validity.fill(0, ParallelCoordsDataSnapshot::segmentRows / 64);
+			segments[i].push_back(seg);
+		}
+		ParallelCoordsDataSnapshot::segment *seg = segments[i].last().data();
+
+		// Validity words are detached from the snapshots sharing them,
+		// see publish(), values and codes are written where they are
+		const qreal v = point[i];
+		const bool valid = !qIsNaN(v);
+		if(valid)
+			seg->validity.data()[offset >> 6] |= bit;
+
+		if(axisTypes[i] == Categorical) {
+			const_cast<quint32*>(seg->codes.constData())[offset] =
+				valid ? static_cast<quint32>(v) : 0;
+			continue;
+		}
+		if(valid) {
+			axisMin[i] = axisMin[i] > v ? v : axisMin[i];
+			axisMax[i] = axisMax[i] < v ? v : axisMax[i];
+			maxValue = maxValue < v ? v : maxValue;
+		}
+		const_cast<qreal*>(seg->values.constData())[offset] = v;
 	}
 
-	data.append(point);
-	if(!bulkUpdate) emit dataChanged(true);
+	row_cnt++;
+}
+
+bool QParallelCoordsData::sameRow(int row, QVector<qreal> const& point) const
+{
+	// Straight from the segments, the row may not be published yet
+	const int s = row >> ParallelCoordsDataSnapshot::segmentShift;
+	const int o = row & (ParallelCoordsDataSnapshot::segmentRows - 1);
+	for(int i=0; i<axis_cnt; i++) {
+		ParallelCoordsDataSnapshot::segment const *seg = segments[i][s].data();
+		const bool valid = (seg->validity[o >> 6] >> (o & 63)) & 1;
+		if(valid == qIsNaN(point[i]))
+			return false;
+		if(!valid)
+			continue;
+
+		qreal v;
+		if(axisTypes[i] == Categorical)
+			v = seg->codes[o];
+		else if(seg->packed.encoding != ParallelCoordsColumnCodec::Plain)
+			ParallelCoordsColumnCodec::decode(seg->packed, o, 1, &v);
+		else
+			v = seg->values[o];
+		if(v != point[i])
+			return false;
+	}
+	return true;
 }
 
 void QParallelCoordsData::addPoints(QList<QVector<qreal>> pts)
 {
-	bulkUpdate = true;
-	foreach(QVector<qreal> pt, pts) {
-		addPoint(pt);
+	if(externalColumns())
+		return;
+
+	foreach(QVector<qreal> const& pt, pts) {
+		appendPoint(pt);
+	}
+	compressSegments();
+	publish();
+	emit dataChanged(true);
+}
+
+namespace {
+
+// Runs on a copy of the filter, the data may replace its own meanwhile
+ParallelCoordsRowMask selectRows(ParallelCoordsFilter filter,
+	ParallelCoordsDataSnapshot::pointer data, ParallelCoordsRowMask previous)
+{
+	return filter.select(data.data(), previous);
+}
+
+}
+
+QParallelCoordsData::compressJob QParallelCoordsData::runCompress(
+	compressJob const& job)
+{
+	compressJob done = job;
+	done.packed = ParallelCoordsColumnCodec::encode(
+		job.seg->values.constData(), job.seg->validity.constData(),
+		ParallelCoordsDataSnapshot::segmentRows);
+	return done;
+}
+
+void QParallelCoordsData::compressSegments()
+{
+	// A full segment is never written again, so it is encoded on the
+	// pool while rows keep coming. One batch at a time, the segments
+	// filled meanwhile go with the next one.
+	const int fullSegments = row_cnt >> ParallelCoordsDataSnapshot::segmentShift;
+	if(!compression || externalColumns() || compressWatcher->isRunning() ||
+	   fullSegments <= compressedSegments)
+		return;
+
+	QVector<compressJob> jobs;
+	for(int i=0; i<axis_cnt; i++) {
+		if(axisTypes[i] == Categorical)
+			continue;
+		for(int j=compressedSegments; j<fullSegments; j++) {
+			compressJob job = {segments[i][j], ParallelCoordsColumnCodec::block(),
+				i, j};
+			jobs.push_back(job);
+		}
+	}
+	compressingSegments = fullSegments;
+	compressWatcher->setFuture(QtConcurrent::mapped(jobs, runCompress));
+}
+
+void QParallelCoordsData::segmentsCompressed()
+{
+	// Turned off meanwhile, the segments stay as they are
+	if(!compression)
+		return;
+
+	// The compressed copy replaces a segment for the snapshots to
+	// come, the ones out there keep the old one alive for as long as
+	// they need it
+	QList<compressJob> jobs = compressWatcher->future().results();
+	foreach(compressJob const& job, jobs) {
+		if(job.packed.encoding == ParallelCoordsColumnCodec::Plain)
+			continue;
+		segmentPointer seg(new ParallelCoordsDataSnapshot::segment);
+		seg->validity = job.seg->validity;
+		seg->packed = job.packed;
+		segments[job.axis][job.index] = seg;
+	}
+	compressedSegments = compressingSegments;
+	publish();
+	compressSegments();
+}
+
+void QParallelCoordsData::setCompression(bool state)
+{
+	compression = state;
+	compressSegments();
+}
+
+bool QParallelCoordsData::isCompressed() const
+{
+	return compression;
+}
+
+qint64 QParallelCoordsData::columnBytes() const
+{
+	if(columnFile)
+		return 0;
+	if(shmColumns)
+		return static_cast<qint64>(axis_cnt) * row_cnt * sizeof(qreal);
+
+	qint64 bytes = static_cast<qint64>(weights.count()) *
+		ParallelCoordsDataSnapshot::segmentRows * sizeof(quint32);
+	for(int i=0; i<axis_cnt; i++) {
+		foreach(segmentPointer const& s, segments[i]) {
+			bytes += s->validity.count() * sizeof(quint64) +
+				s->codes.count() * sizeof(quint32) +
+				(s->packed.encoding == ParallelCoordsColumnCodec::Plain ?
+					s->values.count() * sizeof(qreal) :
+					ParallelCoordsColumnCodec::byteSize(s->packed));
+		}
+	}
+	return bytes;
+}
+
+void QParallelCoordsData::setDeduplication(bool state)
+{
+	// only before any rows are in
+	if(row_cnt == 0 && !externalColumns()) {
+		dedup = state;
+		publish();
+	}
+}
+
+bool QParallelCoordsData::isDeduplicated() const
+{
+	return dedup;
+}
+
+bool QParallelCoordsData::setFilter(QString text)
+{
+	ParallelCoordsFilter *next = nullptr;
+	if(!text.trimmed().isEmpty()) {
+		next = new ParallelCoordsFilter();
+		if(!next->compile(text, this)) {
+			filterMessage = next->errorString();
+			delete next;
+			return false;
+		}
+	}
+
+	delete filter;
+	filter = next;
+	filterMessage.clear();
+	filterGeneration++;
+
+	// Without a filter every row is drawn right away, a new one is
+	// evaluated over every row on the pool
+	selectedRows = -1;
+	if(!filter) {
+		selected.clear();
+		publish();
+		emit filterChanged();
+		return true;
+	}
+	updateSelection();
+	return true;
+}
+
+void QParallelCoordsData::updateSelection()
+{
+	// One selection at a time, the next one picks up whatever came
+	// in meanwhile
+	if(!filter || selectedRows == row_cnt || selectWatcher->isRunning())
+		return;
+
+	// Rows never change once in, the selection only grows by the
+	// rows appended since the last one
+	selectingRows = row_cnt;
+	selectingGeneration = filterGeneration;
+	selectWatcher->setFuture(QtConcurrent::run(selectRows, *filter,
+		snapshot(), selectedRows >= 0 ? selected : ParallelCoordsRowMask()));
+}
+
+void QParallelCoordsData::selectionReady()
+{
+	// a selection of a filter replaced meanwhile is of no use
+	if(selectingGeneration != filterGeneration) {
+		updateSelection();
+		return;
+	}
+
+	const bool first = selectedRows < 0;
+	selected = selectWatcher->result();
+	selectedRows = selectingRows;
+	publish();
+	if(first)
+		emit filterChanged();
+	else
+		emit dataChanged(false);
+}
+
+QString QParallelCoordsData::filterText() const
+{
+	return filter ? filter->text() : QString();
+}
+
+QString QParallelCoordsData::filterError() const
+{
+	return filterMessage;
+}
+
+ParallelCoordsRowMask QParallelCoordsData::selection() const
+{
+	return selected;
+}
+
+qint64 QParallelCoordsData::weightedLength() const
+{
+	return dedup ? weighted_cnt : row_cnt;
+}
+
+quint32 QParallelCoordsData::weight(int row) const
+{
+	return dedup ? weights[row >> ParallelCoordsDataSnapshot::segmentShift]
+		[row & (ParallelCoordsDataSnapshot::segmentRows - 1)] : 1;
+}
+
+bool QParallelCoordsData::isLoading() const
+{
+	return loading;
+}
+
+void QParallelCoordsData::setLoading(bool state)
+{
+	loading = state;
+	publish();
+}
+
+QVector<qreal> QParallelCoordsData::operator[](int idx) const
+{
+	ParallelCoordsDataSnapshot::pointer s = snapshot();
+	QVector<qreal> row(axis_cnt);
+	for(int i=0; i<axis_cnt; i++)
+		row[i] = s->value(idx, i);
+	return row;
+}
+
+qreal QParallelCoordsData::value(int row, int axis) const
+{
+	return snapshot()->value(row, axis);
+}
+
+QString QParallelCoordsData::valueText(int row, int axis) const
+{
+	ParallelCoordsDataSnapshot::pointer s = snapshot();
+	if(!s->isValid(row, axis))
+		return "?";
+	if(axisTypes[axis] == Categorical)
+		return categoryName(axis, static_cast<int>(s->value(row, axis)));
+	return QString::number(s->value(row, axis));
+}
+
+bool QParallelCoordsData::isValid(int row, int axis) const
+{
+	return snapshot()->isValid(row, axis);
+}
+
+quint64 const* QParallelCoordsData::validityChunk(int axis, int first, int count,
+	QVector<quint64> &buffer) const
+{
+	// Copied, the words of a segment still filling belong to the
+	// snapshot and go away with it
+	ParallelCoordsDataSnapshot::pointer s = snapshot();
+	quint64 const *words = s->validityChunk(axis, first, count, buffer);
+	if(words != buffer.constData()) {
+		const int n = (count + 63) / 64;
+		buffer.resize(n);
+		memcpy(buffer.data(), words, n * sizeof(quint64));
+	}
+	return buffer.constData();
+}
+
+qreal const* QParallelCoordsData::columnChunk(int axis, int first, int count,
+	QVector<qreal> &buffer) const
+{
+	return snapshot()->columnChunk(axis, first, count, buffer);
+}
+
+qreal const* QParallelCoordsData::externalChunk(int axis, int first, int count,
+	QVector<qreal> &buffer) const
+{
+	if(shmColumns)
+		return shmColumns + axis * shmCapacity + first;
+
+	buffer.resize(count);
+	qint64 pos = columnFileOffset + 
+		(static_cast<qint64>(axis) * row_cnt + first) * sizeof(qreal);
+	qint64 size = static_cast<qint64>(count) * sizeof(qreal);
+
+	QMutexLocker locker(&columnFileLock);
+	qint64 got = columnFile->seek(pos) ?
+		columnFile->read(reinterpret_cast<char*>(buffer.data()), size) : -1;
+
+	// A file cut short or failing underneath shows as missing values
+	if(got != size) {
+		qWarning("Could not read rows %d to %d of axis %d from %s: %s",
+			first, first + count - 1, axis, qPrintable(columnFile->fileName()),
+			qPrintable(columnFile->errorString()));
+		const int valid = static_cast<int>(qMax(got, static_cast<qint64>(0)) /
+			static_cast<qint64>(sizeof(qreal)));
+		qFill(buffer.begin() + valid, buffer.end(),
+			std::numeric_limits<qreal>::quiet_NaN());
+	}
+	return buffer.constData();
+}
+
+bool QParallelCoordsData::isOutOfCore() const
+{
+	return columnFile != nullptr;
+}
+
+QByteArray QParallelCoordsData::contentHash() const
+{
+	if(columnFile)
+		return fileFingerprint;
+	if(shmColumns) {
+		// published rows never change, the count is enough
+		QCryptographicHash h(QCryptographicHash::Sha1);
+		h.addData(fileFingerprint);
+		h.addData(QString::number(row_cnt).toUtf8());
+		return h.result();
+	}
+
+	// result() works on a copy of the running state, rows added
+	// later keep extending the same hash
+	QCryptographicHash h(QCryptographicHash::Sha1);
+	h.addData(contentHasher.result());
+	h.addData(QString("%1 %2").arg(axis_cnt).arg(row_cnt).toUtf8());
+	return h.result();
+}
+
+// Version 2 adds the axis types and the category names after the
+// ranges, version 1 files are still read
+static const quint32 columnFileMagic = 0x50434432;	// "PCD2"
+static const quint32 columnFileMagicV1 = 0x50434431;	// "PCD1"
+
+bool QParallelCoordsData::openFile(QString fname)
+{
+	if(axis_cnt != -1)
+		return false;
+
+	QFile *f = new QFile(fname, this);
+	if(!f->open(QIODevice::ReadOnly)) {
+		delete f;
+		return false;
+	}
+
+	QDataStream strm(f);
+	strm.setVersion(QDataStream::Qt_4_6);
+	quint32 magic;
+	quint64 offset;
+	qint32 axisCnt;
+	qint64 rowCnt;
+	QVector<QString> names;
+	QVector<qreal> mins, maxs;
+	QVector<qint32> types;
+	QVector<QStringList> dictionaries;
+	strm >> magic >> offset >> axisCnt >> rowCnt >> names >> mins >> maxs;
+	if(magic == columnFileMagic)
+		strm >> types >> dictionaries;
+	else
+		types.fill(Numeric, qMax(axisCnt, 0));
+	// The header is not trusted. The columns are checked by division
+	// like those of shared memory, a corrupt row count or offset must
+	// not overflow its way past the end of the file.
+	const qint64 headerEnd = f->pos();
+	const qint64 fileBytes = f->size();
+	if(strm.status() != QDataStream::Ok ||
+	   (magic != columnFileMagic && magic != columnFileMagicV1) ||
+	   axisCnt <= 0 || rowCnt < 0 ||
+	   rowCnt > std::numeric_limits<int>::max() ||
+	   names.count() != axisCnt || types.count() != axisCnt ||
+	   mins.count() != axisCnt || maxs.count() != axisCnt ||
+	   (magic == columnFileMagic && dictionaries.count() != axisCnt) ||
+	   offset < static_cast<quint64>(headerEnd) || (offset & 7) != 0 ||
+	   offset > static_cast<quint64>(fileBytes) ||
+	   rowCnt > (fileBytes - static_cast<qint64>(offset)) /
+		   static_cast<qint64>(sizeof(qreal)) / axisCnt) {
+		delete f;
+		return false;
+	}
+
+	setAxisCount(axisCnt);
+	axisNames = names;
+	for(int i=0; i<axisCnt; i++) {
+		if(types[i] == Categorical) {
+			axisTypes[i] = Categorical;
+			categories[i] = dictionaries[i];
+		}
+	}
+	axisMin = mins;
+	axisMax = maxs;
+	foreach(qreal m, maxs) {
+		maxValue = qMax(maxValue, m);
 	}
-	bulkUpdate = false;
+	row_cnt = static_cast<int>(rowCnt);
+	columnFile = f;
+	columnFileOffset = offset;
+
+	// Hashing the columns would mean reading the whole file, the
+	// header together with the size and time stamp has to do
+	{
+		QFileInfo fi(fname);
+		QCryptographicHash h(QCryptographicHash::Sha1);
+		f->seek(0);
+		h.addData(f->read(offset));
+		h.addData(QString("%1 %2").arg(fi.size())
+			.arg(fi.lastModified().toTime_t()).toUtf8());
+		fileFingerprint = h.result();
+	}
+	publish();
+
 	emit dataChanged(true);
+	return true;
 }
 
-QVector<qreal> const& QParallelCoordsData::operator[](int idx) const
+bool QParallelCoordsData::saveFile(QString fname) const
 {
-	return data[idx];
+	// column files have no place for the weights of collapsed rows
+	if(columnFile || axis_cnt <= 0 || dedup)
+		return false;
+
+	QFile f(fname);
+	if(!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	// The header is serialized twice, first to learn its size so the
+	// column data can start on an 8 byte boundary
+	QByteArray header;
+	quint64 offset = 0;
+	for(int pass=0; pass<2; pass++) {
+		header.clear();
+		QDataStream strm(&header, QIODevice::WriteOnly);
+		strm.setVersion(QDataStream::Qt_4_6);
+		QVector<qint32> types;
+		foreach(AxisType t, axisTypes) {
+			types.push_back(t);
+		}
+		strm << columnFileMagic << offset << static_cast<qint32>(axis_cnt)
+			 << static_cast<qint64>(row_cnt) << axisNames << axisMin << axisMax
+			 << types << categories;
+		offset = (header.size() + 7) & ~7;
+	}
+	header.append(QByteArray(offset - header.size(), '\0'));
+	f.write(header);
+
+	// Missing values are written as NaN, categories as their codes
+	QVector<qreal> buffer;
+	for(int i=0; i<axis_cnt; i++) {
+		qint64 size = static_cast<qint64>(row_cnt) * sizeof(qreal);
+		qreal const *col = columnChunk(i, 0, row_cnt, buffer);
+		if(f.write(reinterpret_cast<char const*>(col), size) != size)
+			return false;
+	}
+	return true;
 }
 
 int QParallelCoordsData::length() const
 {
-	return data.length();
+	return row_cnt;
 }
 
 QPair<qreal, qreal> QParallelCoordsData::getRange(int axis) const
 {
-	return axisData[axis].second;
+	return qMakePair(axisMin[axis], axisMax[axis]);
+}
+
+qreal QParallelCoordsData::getMaxValue() const
+{
+	return maxValue;
 }
 
 void QParallelCoordsData::setAxisName(int idx, QString name)
 {
-	axisData[idx].first = name;
+	axisNames[idx] = name;
+}
+
+QString QParallelCoordsData::getAxisName(int idx) const
+{
+	return axisNames[idx];
+}
+
+QParallelCoordsData::AxisType QParallelCoordsData::getAxisType(int idx) const
+{
+	return axisTypes[idx];
+}
+
+void QParallelCoordsData::setAxisType(int idx, AxisType type)
+{
+	// only before any rows are in
+	if(row_cnt == 0 && !externalColumns()) {
+		axisTypes[idx] = type;
+		publish();
+	}
+}
+
+void QParallelCoordsData::addCategories(int idx, QStringList names)
+{
+	if(axisTypes[idx] != Categorical)
+		return;
+
+	categories[idx] << names;
+	foreach(QString name, names) {
+		contentHasher.addData(name.toUtf8());
+	}
+
+	// half a band of margin keeps the first and last category off
+	// the ends of the axis
+	axisMin[idx] = -0.5;
+	axisMax[idx] = categories[idx].count() - 0.5;
+	maxValue = qMax(maxValue, axisMax[idx]);
+
+	// A filter naming a category that was not there yet picks up its
+	// code. Rows come with new codes only after their names, so the
+	// rows selected so far stay as they are.
+	if(filter && filter->missesCategories(idx)) {
+		ParallelCoordsFilter *next = new ParallelCoordsFilter();
+		if(next->compile(filter->text(), this)) {
+			delete filter;
+			filter = next;
+		}
+		else {
+			delete next;
+		}
+	}
+	publish();
+}
+
+int QParallelCoordsData::categoryCount(int idx) const
+{
+	return categories[idx].count();
+}
+
+QString QParallelCoordsData::categoryName(int idx, int code) const
+{
+	return categories[idx].value(code);
+}
+
+bool QParallelCoordsData::openSharedMemory(QString name)
+{
+#ifdef Q_OS_UNIX
+	if(axis_cnt != -1)
+		return false;
+
+	QByteArray shmName = ("/" + name).toLocal8Bit();
+	int fd = shm_open(shmName.constData(), O_RDONLY, 0);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	void *base = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size >= 
+	   static_cast<off_t>(sizeof(ParallelCoordsShmHeader)))
+		base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(base == MAP_FAILED)
+		return false;
+
+	ParallelCoordsShmHeader const *header = 
+		static_cast<ParallelCoordsShmHeader const*>(base);
+	// Sizes are worked out in qint64, the product of two int32 fields
+	// always fits. The columns are checked by division, a corrupt
+	// capacity must not overflow its way past the end of the segment.
+	const qint64 segmentBytes = st.st_size;
+	const qint64 axisCnt = header->axisCnt;
+	const qint64 namesEnd = static_cast<qint64>(sizeof(ParallelCoordsShmHeader)) +
+		axisCnt * header->nameBytes;
+	if(header->magic != parallelCoordsShmMagic ||
+	   header->version != parallelCoordsShmVersion ||
+	   sizeof(qreal) != sizeof(double) ||
+	   axisCnt <= 0 || header->nameBytes <= 0 || header->capacity < 0 ||
+	   (header->dataOffset & 63) != 0 ||
+	   header->dataOffset < namesEnd || header->dataOffset > segmentBytes ||
+	   header->capacity > (segmentBytes - header->dataOffset) /
+		   static_cast<qint64>(sizeof(qreal)) / axisCnt) {
+		munmap(base, st.st_size);
+		return false;
+	}
+
+	setAxisCount(header->axisCnt);
+	char const *names = static_cast<char const*>(base) + 
+		sizeof(ParallelCoordsShmHeader);
+	for(int i=0; i<axis_cnt; i++) {
+		char const *name = names + static_cast<qint64>(i) * header->nameBytes;
+		axisNames[i] = QString::fromUtf8(name, qstrnlen(name, header->nameBytes));
+	}
+	shmBase = base;
+	shmSize = st.st_size;
+	shmCapacity = header->capacity;
+	shmColumns = reinterpret_cast<qreal const*>(
+		static_cast<char const*>(base) + header->dataOffset);
+	fileFingerprint = QCryptographicHash::hash(shmName + " " + 
+		QByteArray::number(static_cast<qint64>(header->createdMsecs)),
+		QCryptographicHash::Sha1);
+
+	shmPoll = new QTimer(this);
+	shmPoll->setInterval(100);
+	connect(shmPoll, SIGNAL(timeout()), this, SLOT(pollSharedMemory()));
+	shmPoll->start();
+	loading = true;
+	publish();
+	emit dataChanged(true);
+	pollSharedMemory();
+	return true;
+#else
+	Q_UNUSED(name);
+	return false;
+#endif
 }
 
-QString QParallelCoordsData::getAxisName(int idx)
+void QParallelCoordsData::pollSharedMemory()
 {
-	return axisData[idx].first;
-}
\ No newline at end of file
+#ifdef Q_OS_UNIX
+	ParallelCoordsShmHeader const *header = 
+		static_cast<ParallelCoordsShmHeader const*>(shmBase);
+	// acquire pairs with the release store of the producer, the
+	// values of every row below it are in place
+	const qint64 published = qMin(
+		static_cast<qint64>(header->published.load(std::memory_order_acquire)),
+		qMin(shmCapacity, static_cast<qint64>(std::numeric_limits<int>::max())));
+	const bool closed = header->closed.load(std::memory_order_acquire) != 0;
+
+	const bool grown = published > row_cnt;
+	if(grown) {
+		// Only the ranges need the new rows, nothing is copied
+		for(int i=0; i<axis_cnt; i++) {
+			qreal const *col = shmColumns + i * shmCapacity;
+			for(qint64 r=row_cnt; r<published; r++) {
+				const qreal v = col[r];
+				if(qIsNaN(v))
+					continue;
+				axisMin[i] = axisMin[i] > v ? v : axisMin[i];
+				axisMax[i] = axisMax[i] < v ? v : axisMax[i];
+				maxValue = maxValue < v ? v : maxValue;
+			}
+		}
+		row_cnt = static_cast<int>(published);
+	}
+
+	if(closed) {
+		shmPoll->stop();
+		loading = false;
+	}
+	if(grown || closed) {
+		publish();
+		emit dataChanged(true);
+	}
+#endif
+}
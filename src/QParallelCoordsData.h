@@ -1,35 +1,187 @@
-
 #ifndef __QPARALLELCOORDSDATA_H__
 #define __QPARALLELCOORDSDATA_H__
 
 #include "ParallelCoordinates.h"
+#include "ParallelCoordsDataSnapshot.h"
+#include "ParallelCoordsPublished.h"
+
+class ParallelCoordsFilter;
 
 class QParallelCoordsData : public QObject {
 
 	Q_OBJECT
 
 public:
+	// Categorical axes hold strings, stored as codes into a dictionary
+	// and laid out evenly along the axis in order of appearance
+	enum AxisType { Numeric, Categorical };
+
 	QParallelCoordsData(QObject *parent, int axisCnt_=-1);
+	~QParallelCoordsData();
 	void addPoint(QVector<qreal> point);
 	void addPoints(QList<QVector<qreal>> pts);
-	QVector<qreal> const& operator[](int idx) const;
+	// Rows are not stored, this materializes one from the columns.
+	// Missing values are NaN in rows, values and column chunks. Each
+	// call reads the latest snapshot, loops over many rows should take
+	// snapshot() once and read that.
+	QVector<qreal> operator[](int idx) const;
+	qreal value(int row, int axis) const;
+	QString valueText(int row, int axis) const;
+	bool isValid(int row, int axis) const;
+	// count values of an axis starting at row first. Points into the
+	// column when the rows are in memory within one segment, otherwise
+	// buffer is filled from disk, the segments or the category codes
+	qreal const* columnChunk(int axis, int first, int count,
+		QVector<qreal> &buffer) const;
+	// One bit per row starting at row first, which has to be a
+	// multiple of 64. Bits are set where the value is present.
+	quint64 const* validityChunk(int axis, int first, int count,
+		QVector<quint64> &buffer) const;
 	int length() const;
 	QPair<qreal, qreal> getRange(int axis) const;
+	qreal getMaxValue() const;
 	void setRange(int axis_idx, QPair<qreal, qreal> range);
 	void setRange(int start_idx, QList<QPair<qreal, qreal>> const& ranges);
 	int axis_count() const;
 	void setAxisCount(int cnt);
-	QString getAxisName(int idx);
+	QString getAxisName(int idx) const;
 	void setAxisName(int idx, QString name);
+	AxisType getAxisType(int idx) const;
+	void setAxisType(int idx, AxisType type);
+	// Appends to the dictionary of a categorical axis
+	void addCategories(int idx, QStringList names);
+	int categoryCount(int idx) const;
+	QString categoryName(int idx, int code) const;
+
+	// Column files keep a small header followed by one contiguous
+	// block of native doubles per axis. Opening one leaves the
+	// columns on disk, they are only read in chunks when needed.
+	bool openFile(QString fname);
+	bool saveFile(QString fname) const;
+	bool isOutOfCore() const;
+
+	// Maps a segment filled by another process, see
+	// ParallelCoordsShmLayout.h. Columns are read where the producer
+	// wrote them and new rows are picked up as they are published.
+	bool openSharedMemory(QString name);
+
+	// Numeric segments are compressed once they are full, each with
+	// whichever lossless encoding suits it, see
+	// ParallelCoordsColumnCodec. Segments are encoded on the pool and
+	// swapped in when done. Turning it on compresses the full segments
+	// already in, turning it off leaves them as they are.
+	void setCompression(bool state);
+	bool isCompressed() const;
+	// Bytes the columns take in memory
+	qint64 columnBytes() const;
+
+	// Rows equal in every value are kept once with a count of how
+	// many times they were read, renderers weigh them by it. Only
+	// before any rows are in, column files and shared memory are
+	// never collapsed.
+	void setDeduplication(bool state);
+	bool isDeduplicated() const;
+	// Rows read, counting the ones collapsed into others
+	qint64 weightedLength() const;
+	quint32 weight(int row) const;
+
+	// Only rows matching a filter such as `latency > 200 && region == 3`
+	// are drawn, see ParallelCoordsFilter. The rows are selected on the
+	// pool and filterChanged() is sent once they are, until then the
+	// selection before stays in place. It is kept up to date as rows
+	// come in, rows it has not seen yet are not drawn. An empty text
+	// draws every row again. False with the reason in filterError() if
+	// text does not parse, the filter in use is then left as it is.
+	bool setFilter(QString text);
+	QString filterText() const;
+	QString filterError() const;
+	// Rows matching the filter, nullptr without one
+	ParallelCoordsRowMask selection() const;
+
+	// Identifies the content, equal for the same file loaded again
+	QByteArray contentHash() const;
+
+	// Everything but this is for the thread that owns the data.
+	// Other threads read the snapshot, a new one is published after
+	// every change.
+	ParallelCoordsDataSnapshot::pointer snapshot() const;
+
+	// Set while rows are still coming in
+	bool isLoading() const;
+	void setLoading(bool state);
 
 private:
 	int axis_cnt;
-	QList<QVector<qreal>> data;
-	QList<QPair<QString,QPair<qreal, qreal>>> axisData;
-	bool bulkUpdate;
+	int row_cnt;
+	// Column major storage in segments of a fixed number of rows,
+	// only the columns of visible axes are touched while rendering
+	typedef QSharedPointer<ParallelCoordsDataSnapshot::segment> segmentPointer;
+	QVector<QVector<segmentPointer>> segments;
+	QVector<AxisType> axisTypes;
+	QVector<QStringList> categories;
+	QVector<QString> axisNames;
+	QVector<qreal> axisMin;
+	QVector<qreal> axisMax;
+	qreal maxValue;
+	bool loading;
+	bool compression;
+	int compressedSegments;			// segments per axis looked at so far
+	// One full segment of one axis, encoded on the pool
+	struct compressJob {
+		QSharedPointer<ParallelCoordsDataSnapshot::segment> seg;
+		ParallelCoordsColumnCodec::block packed;
+		int axis;
+		int index;
+	};
+	QFutureWatcher<compressJob> *compressWatcher;
+	int compressingSegments;		// looked at once the encoding is done
+	static compressJob runCompress(compressJob const& job);
+	bool dedup;
+	qint64 weighted_cnt;
+	QVector<QVector<quint32>> weights;	// per segment, only with dedup
+	QMultiHash<uint, int> rowIndex;		// hash of a row to the rows with it
+	ParallelCoordsFilter *filter;		// nullptr selects every row
+	ParallelCoordsRowMask selected;
+	int selectedRows;					// rows the selection covers
+	QString filterMessage;
+	quint32 filterGeneration;			// bumped by every new filter
+	QFutureWatcher<ParallelCoordsRowMask> *selectWatcher;
+	int selectingRows;					// of the selection under way
+	quint32 selectingGeneration;
+	ParallelCoordsPublished<ParallelCoordsDataSnapshot> published;
+
+	void appendPoint(QVector<qreal> const& point);
+	bool sameRow(int row, QVector<qreal> const& point) const;
+	void compressSegments();
+	void publish();
+	void updateSelection();
+
+	QFile *columnFile;
+	qint64 columnFileOffset;
+	mutable QMutex columnFileLock;
+
+	QCryptographicHash contentHasher;
+	QByteArray fileFingerprint;
+
+	void *shmBase;
+	qint64 shmSize;
+	qreal const *shmColumns;
+	qint64 shmCapacity;
+	QTimer *shmPoll;
+
+	bool externalColumns() const;
+	friend class ParallelCoordsDataSnapshot;
+	qreal const* externalChunk(int axis, int first, int count,
+		QVector<qreal> &buffer) const;
+
+private slots:
+	void pollSharedMemory();
+	void selectionReady();
+	void segmentsCompressed();
 
 signals:
 	void dataChanged(bool);
+	void filterChanged();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,8 +1,9 @@
 
 #include "ParallelCoordinates.h"
 #include "QParallelCoordsWidget.h"
-#include "ParallelCoordsRenderThread.h"
+#include "ParallelCoordsRenderService.h"
 #include "ParallelCoordsRenderManager.h"
+#include "ParallelCoordsAxisOrdering.h"
 #include <memory>
 
 QParallelCoordsWidget::QParallelCoordsWidget(QParallelCoordsData const *data_, 
@@ -12,52 +13,112 @@ QParallelCoordsWidget::QParallelCoordsWidget(QParallelCoordsData const *data_,
 	inter_axis_width = 0;
 	axis_box_width = 0;
 	scale_x = scale_y = 1;
+	density_x = density_y = 1;
 	img = nullptr;
 	currImgValid = false;
 	isAxisSelected = false;
 	axisMoveEngaged = false;
-	axis_data = new QList<axis_view_data>();\
+	axis_data = new QVector<axis_view_data>();
 	selectedAxis = axis_data->end();
 	rubberBand = nullptr;
+	pickPending = pickQueued = false;
+	tileRequested = tileRequestStale = false;
+	viewVersion = staleVersion = 0;
+	tileRequestMsecs = 0;
+	frameClock.start();
+	trace = nullptr;
+	pickTolerance = 3;
+	viewport()->setMouseTracking(true);
+	reorderWatcher = new QFutureWatcher<QVector<int>>(this);
+	connect(reorderWatcher, SIGNAL(finished()), this, SLOT(applyAxisOrder()));
+	summaryMode = false;
+	openedCluster = -1;
+	memoryLimit = 256 * 1024 * 1024;
+	memberWatcher = new QFutureWatcher<ParallelCoordsRowMask>(this);
+	connect(memberWatcher, SIGNAL(finished()), this, SLOT(applyMembers()));
+	connect(data, SIGNAL(filterChanged()), this, SLOT(filterChange()));
 
 	doLayout();
 
 	renderManager = new ParallelCoordsRenderManager(
 		canvas_size,
-		qMakePair(scale_x, scale_y),
+		qMakePair(density_x, density_y),
 		viewport()->size(),
-		axis_data,
+		ParallelCoordsLayout(new QVector<axis_view_data>(*axis_data)),
 		data);
 
-	renderThread = new ParallelCoordsRenderThread(this, renderManager);
-	renderThread->start();
+	// Views of the same data share one render service
+	renderService = ParallelCoordsRenderService::attach(this, renderManager);
+	brushedRows = renderService->brushedRows();
 }
 
 QParallelCoordsWidget::~QParallelCoordsWidget()
 {
-	delete renderThread;
+	// the manager is deleted on the render thread, it may still be
+	// busy with a tile for a moment
+	renderService->detach(this, renderManager);
 	delete axis_data;
 }
 
+void QParallelCoordsWidget::updateDensity()
+{
+	// Pixels per canvas unit are set by the zoom level, at the size
+	// of the viewport when zooming. Resizing later shows more or less
+	// of the canvas at the same density, the tiles stay valid.
+	QSize viewportSize = viewport()->size();
+	if(canvas_size.isEmpty() || viewportSize.isEmpty())
+		return;
+	density_x = viewportSize.width() / (canvas_size.width() * scale_x);
+	density_y = viewportSize.height() / (canvas_size.height() * scale_y);
+	viewVersion++;
+	emit densityChange(qMakePair(density_x, density_y));
+}
+
+QSizeF QParallelCoordsWidget::visibleExtent() const
+{
+	QSizeF viewportSize = viewport()->size();
+	return QSizeF(viewportSize.width() / density_x,
+				  viewportSize.height() / density_y);
+}
+
+QRect QParallelCoordsWidget::visibleRect() const
+{
+	QSizeF visible_extent = visibleExtent();
+	return QRect(horizontalScrollBar()->value(),
+				 verticalScrollBar()->value(),
+				 qRound(visible_extent.width()),
+				 qRound(visible_extent.height()));
+}
+
+void QParallelCoordsWidget::mapPreview(qreal oldPitch, qreal oldBoxWidth)
+{
+	// Axes sit at i * pitch + box / 2, so a new spacing moves every x
+	// of the canvas by the same linear map
+	const qreal pitch = inter_axis_width + axis_box_width;
+	if(oldPitch <= 0 || pitch <= 0)
+		return;
+	QTransform m = QTransform::fromTranslate(-oldBoxWidth / 2, 0) *
+		QTransform::fromScale(pitch / oldPitch, 1) *
+		QTransform::fromTranslate(axis_box_width / 2.0, 0);
+	previewMap *= m;
+	requestMap *= m;
+}
+
 void QParallelCoordsWidget::setup_scrollbar()
 {
-	QSizeF visible_extent;
-	visible_extent.setWidth(canvas_size.width() * scale_x);
-	visible_extent.setHeight(canvas_size.height() * scale_y);
+	QSizeF visible_extent = visibleExtent();
 
+	// a larger viewport may need less scrolling or none at all
 	QSize scroll_size = (canvas_size - visible_extent).toSize();
+	scroll_size = scroll_size.expandedTo(QSize(0, 0));
 
-	if(scroll_size.width() > 0) { // have to scroll horizontally
-		int step = scroll_size.width()*0.3;
-		horizontalScrollBar()->setPageStep(step > 1 ? step : 1);
-		horizontalScrollBar()->setRange(0, scroll_size.width());
-	}
+	int step = scroll_size.width()*0.3;
+	horizontalScrollBar()->setPageStep(step > 1 ? step : 1);
+	horizontalScrollBar()->setRange(0, scroll_size.width());
 
-	if(scroll_size.height() > 0) { // have to scroll vertically
-		int step = scroll_size.height()*0.3;
-		verticalScrollBar()->setPageStep(step > 1 ? step : 1);
-		verticalScrollBar()->setRange(0, scroll_size.height());
-	}
+	step = scroll_size.height()*0.3;
+	verticalScrollBar()->setPageStep(step > 1 ? step : 1);
+	verticalScrollBar()->setRange(0, scroll_size.height());
 }
 
 void QParallelCoordsWidget::doLayout()
@@ -65,24 +126,163 @@ void QParallelCoordsWidget::doLayout()
 	int y_extent = 0;
 	int x_extent = 0;
 
-	for(int i=0; i<data->axis_count(); i++) {
-		auto range = data->getRange(i);
-		y_extent = y_extent < range.second ? range.second : y_extent;
-	}
+	if(data->length() > 0 && data->getMaxValue() > 0)
+		y_extent = data->getMaxValue();
 
 	x_extent = data->axis_count() * axis_box_width + 
 			   (data->axis_count()-1) * inter_axis_width;
 
 	canvas_size = QSize(x_extent, y_extent);
 
-	qreal x_offset = 0;
-	for(int i=0; i<axis_data->count(); i++)
-	{
-		(*axis_data)[i].pos = QPointF(x_offset + axis_box_width/2.0, 0);
-		(*axis_data)[i].bounding_box = QRectF(x_offset, 0, 
-			x_offset + axis_box_width, canvas_size.height());
-		x_offset += inter_axis_width + axis_box_width;
+	// Single pass over a flat array. Positions of all axes are kept,
+	// reordering, dragging and the binary search for the visible range
+	// work on them, and at one add per axis it costs next to nothing
+	// even for thousands. Everything done per frame afterwards only
+	// looks at the axes in the visible range.
+	const qreal pitch = inter_axis_width + axis_box_width;
+	const int axisCnt = axis_data->count();
+	axis_view_data *axes = axis_data->data();
+	for(int i=0; i<axisCnt; i++)
+		axes[i].x = i * pitch + axis_box_width/2.0;
+}
+
+void QParallelCoordsWidget::publishLayout()
+{
+	// The render thread gets a copy of its own, axis_data stays free
+	// to change here while it renders
+	renderManager->setLayout(
+		ParallelCoordsLayout(new QVector<axis_view_data>(*axis_data)));
+}
+
+QSize QParallelCoordsWidget::getCanvasSize() const
+{
+	return canvas_size;
+}
+
+ParallelCoordsPosterExport* QParallelCoordsWidget::createPosterExport(
+	QObject *parent) const
+{
+	return new ParallelCoordsPosterExport(parent, data, *axis_data, canvas_size,
+		memoryLimit);
+}
+
+void QParallelCoordsWidget::setTrace(ParallelCoordsTrace *trace_)
+{
+	trace = trace_;
+	if(trace == nullptr) return;
+
+	// The starting state, a replay begins from the same view
+	QSize s = size();
+	trace->record("resize", QList<qreal>() << s.width() << s.height());
+	trace->record("spacing", QList<qreal>() << inter_axis_width);
+	trace->record("box", QList<qreal>() << axis_box_width);
+	trace->record("scale", QList<qreal>() << scale_x << scale_y);
+	trace->record("scroll", QList<qreal>() << horizontalScrollBar()->value()
+		<< verticalScrollBar()->value());
+}
+
+void QParallelCoordsWidget::replay(ParallelCoordsTrace::event const& e)
+{
+	QList<qreal> const& a = e.args;
+	if(e.kind == "scroll" && a.count() == 2) {
+		horizontalScrollBar()->setValue(a[0]);
+		verticalScrollBar()->setValue(a[1]);
+	}
+	else if(e.kind == "scale" && a.count() == 2) {
+		setXScale(a[0]);
+		setYScale(a[1]);
 	}
+	else if(e.kind == "spacing" && a.count() == 1) {
+		setInterAxisWidth(a[0]);
+	}
+	else if(e.kind == "box" && a.count() == 1) {
+		setAxisBoxWidth(a[0]);
+	}
+	else if(e.kind == "resize" && a.count() == 2) {
+		// The view usually sits in a layout, so its window is resized
+		// by the difference instead
+		if(isWindow())
+			resize(a[0], a[1]);
+		else
+			window()->resize(window()->size() + QSize(a[0], a[1]) - size());
+	}
+	else if(e.kind == "move" && a.count() == 2) {
+		moveAxis(a[0], a[1]);
+	}
+}
+
+void QParallelCoordsWidget::moveAxis(int idx, qreal x)
+{
+	int i = 0;
+	while(i < axis_data->count() && (*axis_data)[i].index != idx)
+		i++;
+	if(i == axis_data->count())
+		return;
+
+	(*axis_data)[i].x = x;
+	qSort(axis_data->begin(), axis_data->end(), 
+		[](axis_view_data a, axis_view_data b) 
+		{return a.x < b.x;});
+	isAxisSelected = false;
+	selectedAxis = axis_data->end();
+
+	if(trace)
+		trace->record("move", QList<qreal>() << idx << x);
+	publishLayout();
+	viewVersion++;
+	emit axisDataChange();
+	viewport()->update();
+}
+
+bool QParallelCoordsWidget::isIdle() const
+{
+	return !tileRequested && !tileRequestStale && img == nullptr;
+}
+
+void QParallelCoordsWidget::setRowMask(ParallelCoordsRowMask mask)
+{
+	renderManager->setRowMask(mask);
+	viewVersion++;
+	emit rowMaskChange();
+	viewport()->update();
+}
+
+void QParallelCoordsWidget::setSummaryMode(bool on)
+{
+	summaryMode = on;
+	viewport()->update();
+}
+
+void QParallelCoordsWidget::setClusterSummary(
+	ParallelCoordsClusterSummary summary_)
+{
+	summary = summary_;
+	if(summaryMode)
+		viewport()->update();
+}
+
+void QParallelCoordsWidget::showAllRows()
+{
+	summaryMode = false;
+	setRowMask(ParallelCoordsRowMask());
+}
+
+void QParallelCoordsWidget::applyMembers()
+{
+	// The rows of a cluster are drawn like any others, only the mask
+	// keeps the rest out
+	ParallelCoordsRowMask mask = memberWatcher->result();
+	summaryMode = false;
+	setRowMask(mask);
+	emit clusterOpened(openedCluster, mask->rowCount());
+}
+
+void QParallelCoordsWidget::filterChange()
+{
+	// the tiles in memory were drawn with the old selection
+	viewVersion++;
+	emit rowMaskChange();
+	viewport()->update();
 }
 
 void QParallelCoordsWidget::updateLayout()
@@ -90,6 +290,27 @@ void QParallelCoordsWidget::updateLayout()
 	updateView(true);
 }
 
+void QParallelCoordsWidget::reorderAxes()
+{
+	// Correlations over large data sets take a while
+	// compute them off the GUI thread and apply when ready
+	if(reorderWatcher->isRunning() || data->axis_count() <= 2)
+		return;
+	reorderWatcher->setFuture(QtConcurrent::run(
+		ParallelCoordsAxisOrdering::computeOrder, data));
+}
+
+void QParallelCoordsWidget::applyAxisOrder()
+{
+	QVector<int> order = reorderWatcher->result();
+	if(order.count() != axis_data->count())
+		return;
+
+	for(int i=0; i<order.count(); i++)
+		(*axis_data)[i].index = order[i];
+	updateView(true);
+}
+
 qreal QParallelCoordsWidget::getXScale() const
 {
 	return scale_x;
@@ -97,9 +318,10 @@ qreal QParallelCoordsWidget::getXScale() const
 
 void QParallelCoordsWidget::setXScale(qreal scale)
 {
-	currImgValid = false;
 	scale_x = scale;
-	emit scaleFactorsChange(qMakePair(scale_x, scale_y));
+	if(trace)
+		trace->record("scale", QList<qreal>() << scale_x << scale_y);
+	updateDensity();
 	updateView();
 }
 
@@ -110,9 +332,10 @@ qreal QParallelCoordsWidget::getYScale() const
 
 void QParallelCoordsWidget::setYScale(qreal scale)
 {
-	currImgValid = false;
 	scale_y = scale;
-	emit scaleFactorsChange(qMakePair(scale_x, scale_y));
+	if(trace)
+		trace->record("scale", QList<qreal>() << scale_x << scale_y);
+	updateDensity();
 	updateView();
 }
 
@@ -129,6 +352,9 @@ void QParallelCoordsWidget::setYScale(int scale)
 void QParallelCoordsWidget::resizeEvent(QResizeEvent *event)
 {
 	Q_UNUSED(event);
+	if(trace)
+		trace->record("resize", QList<qreal>() << width() << height());
+	viewVersion++;
 	emit viewportSizeChange(viewport()->size());
 	updateView();
 }
@@ -137,6 +363,9 @@ void QParallelCoordsWidget::scrollContentsBy(int dx, int dy)
 {
 	Q_UNUSED(dx);
 	Q_UNUSED(dy);
+	if(trace)
+		trace->record("scroll", QList<qreal>() << horizontalScrollBar()->value()
+			<< verticalScrollBar()->value());
 	updateView();
 }
 
@@ -147,10 +376,20 @@ int QParallelCoordsWidget::getInterAxisWidth() const
 
 void QParallelCoordsWidget::setInterAxisWidth(int w)
 {
+	const qreal oldPitch = inter_axis_width + axis_box_width;
 	inter_axis_width = w;
+	mapPreview(oldPitch, axis_box_width);
+	if(trace)
+		trace->record("spacing", QList<qreal>() << w);
 	updateView(true);
 }
 
+void QParallelCoordsWidget::setMemoryLimit(int megabytes)
+{
+	memoryLimit = static_cast<qint64>(megabytes) * 1024 * 1024;
+	emit memoryLimitChange(memoryLimit);
+}
+
 int QParallelCoordsWidget::getAxisBoxWidth() const
 {
 	return axis_box_width;
@@ -158,7 +397,12 @@ int QParallelCoordsWidget::getAxisBoxWidth() const
 
 void QParallelCoordsWidget::setAxisBoxWidth(int w)
 {
+	const qreal oldPitch = inter_axis_width + axis_box_width;
+	const qreal oldBoxWidth = axis_box_width;
 	axis_box_width = w;
+	mapPreview(oldPitch, oldBoxWidth);
+	if(trace)
+		trace->record("box", QList<qreal>() << w);
 	updateView(true);
 }
 
@@ -166,18 +410,20 @@ void QParallelCoordsWidget::updateView(bool doLayout_)
 {
 	isAxisSelected = false;
 	selectedAxis = axis_data->end();
-	if(axis_data->count() != data->axis_count()) {
-		axis_data->clear();
+	if(axis_data->count() != qMax(data->axis_count(), 0)) {
+		axis_data->resize(qMax(data->axis_count(), 0));
 
-		for(int i=0; i<data->axis_count(); i++) {
-			axis_view_data avd = {i, QRectF(), QPointF()};
-			axis_data->push_back(avd);
-		}
+		axis_view_data *axes = axis_data->data();
+		for(int i=0; i<axis_data->count(); i++)
+			axes[i].index = i;
 		doLayout_ = true;
 	}
 
 	if(doLayout_) {
 		doLayout();
+		updateDensity();
+		publishLayout();
+		viewVersion++;
 		emit axisDataChange();
 		emit canvasSizeChange(canvas_size);
 	}
@@ -188,6 +434,19 @@ void QParallelCoordsWidget::updateView(bool doLayout_)
 
 void QParallelCoordsWidget::mousePressEvent(QMouseEvent *event)
 {
+	// A click on a cluster picks out its rows, over all the data
+	// which takes a moment
+	if(summaryMode) {
+		int cluster = clusterAt(event->pos());
+		if(cluster < 0 || memberWatcher->isRunning())
+			return;
+		openedCluster = cluster;
+		memberWatcher->setFuture(QtConcurrent::run(
+			ParallelCoordsClustering::members, data->snapshot(), summary,
+			cluster));
+		return;
+	}
+
 	// We need a valid current image to process this event
 	// nothing on display nothing to process
 	if(!currImgValid)
@@ -222,19 +481,19 @@ void QParallelCoordsWidget::mousePressEvent(QMouseEvent *event)
 
 	auto compare = [](axis_view_data const& a, axis_view_data const& b)
 	{
-		return a.pos.x() < b.pos.x();	
+		return a.x < b.x;	
 	};
 
 	// determine the axes just before the left and just after the right margins
-	axis_view_data ptPos = {-1, QRectF(), QPointF(pt.x(), -1)};
+	axis_view_data ptPos = {-1, static_cast<qreal>(pt.x())};
 	auto pos = qLowerBound(axis_data->begin(), 
 		axis_data->end(), ptPos, compare);
-	auto axis = axis_data->end();
 
-	if(pos == axis_data->end() || (pos->pos.x() - pt.x() > 10)) {
+	if(pos == axis_data->end() || (pos->x - pt.x() > 10)) {
 		isAxisSelected = false;
 		emit axisSelected(-1);
 		viewport()->repaint();
+		pickAt(event->pos());
 		return;
 	}
 
@@ -255,10 +514,237 @@ bool QParallelCoordsWidget::getCurveMode()
 	return curveMode;
 }
 
+void QParallelCoordsWidget::pickAt(QPoint viewportPos)
+{
+	if(!currImgValid)
+		return;
+
+	// Only one pick is in flight at a time, while the render thread is
+	// busy the latest position replaces any queued one
+	pickPos = viewportPos;
+	if(pickPending) {
+		pickQueued = true;
+		return;
+	}
+
+	QSize viewportSize = viewport()->size();
+	QTransform t;
+	t.scale(static_cast<double>(viewportSize.width())/curr_rect.width(), 
+		static_cast<double>(viewportSize.height())/curr_rect.height());
+	t.translate(curr_rect.left()*-1.0, curr_rect.top()*-1.0);
+	QTransform inv = t.inverted();
+
+	qreal tolerance = inv.mapRect(QRectF(0, 0, 1, pickTolerance)).height();
+	pickPending = true;
+	pickQueued = false;
+	emit requestPick(inv.map(QPointF(pickPos)), tolerance);
+}
+
+void QParallelCoordsWidget::pickResult(QPointF pt, QVector<int> rows)
+{
+	Q_UNUSED(pt);
+	pickPending = false;
+	renderService->brush(rows);
+	emit rowsPicked(rows);
+	if(pickQueued)
+		pickAt(pickPos);
+}
+
+void QParallelCoordsWidget::setBrushedRows(QVector<int> rows)
+{
+	brushedRows = rows;
+	viewport()->update();
+}
+
+void QParallelCoordsWidget::drawBrush(QPainter &painter, QRect rect)
+{
+	// Brushed rows are few, they are projected here on the gui thread
+	// which is also where rows get appended
+	if(brushedRows.isEmpty() || rect.isEmpty())
+		return;
+
+	QSizeF viewportSize = viewport()->size();
+	QTransform t;
+	t.scale(viewportSize.width()/rect.width(),
+			viewportSize.height()/rect.height());
+	t.translate(rect.left() * -1, rect.top() * -1);
+
+	QPen p;
+	p.setWidthF(2);
+	p.setColor(QColor(0, 0, 255));
+	painter.save();
+	painter.setPen(p);
+	ParallelCoordsDataSnapshot::pointer snapshot = data->snapshot();
+	foreach(int row, brushedRows) {
+		if(row >= snapshot->length())
+			continue;
+		QPolygonF line;
+		foreach(axis_view_data const& a, *axis_data) {
+			QPair<qreal, qreal> range = snapshot->getRange(a.index);
+			qreal v = snapshot->value(row, a.index);
+			if(qIsNaN(v)) {
+				// gaps where values are missing
+				if(line.count() > 1)
+					painter.drawPolyline(t.map(line));
+				line.clear();
+				continue;
+			}
+			line << QPointF(a.x, (v - range.first) * canvas_size.height() /
+				(range.second - range.first));
+		}
+		if(line.count() > 1)
+			painter.drawPolyline(t.map(line));
+	}
+	painter.restore();
+}
+
+void QParallelCoordsWidget::drawClusters(QPainter &painter, QRect rect)
+{
+	// A band between the quantiles and the centroid line of every
+	// cluster, as quick to draw for any number of rows
+	painter.fillRect(viewport()->rect(), Qt::white);
+	if(rect.isEmpty())
+		return;
+
+	QSizeF viewportSize = viewport()->size();
+	QTransform t;
+	t.scale(viewportSize.width()/rect.width(),
+			viewportSize.height()/rect.height());
+	t.translate(rect.left() * -1, rect.top() * -1);
+
+	painter.save();
+	QPen p;
+	p.setWidthF(2);
+	p.setColor(Qt::black);
+	painter.setPen(p);
+	foreach(axis_view_data const& a, *axis_data) {
+		if(a.x >= rect.left() && a.x <= rect.right())
+			painter.drawLine(t.map(QLineF(a.x, 0, a.x, canvas_size.height())));
+	}
+	if(summary.axisCnt != data->axis_count()) {
+		painter.restore();
+		return;
+	}
+
+	auto canvasY = [this](int axis, qreal v)
+	{
+		QPair<qreal, qreal> range = data->getRange(axis);
+		return (v - range.first) * canvas_size.height() /
+			(range.second - range.first);
+	};
+
+	painter.setRenderHint(QPainter::Antialiasing);
+	for(int c=0; c<summary.clusterCnt; c++) {
+		QColor color = QColor::fromHsv(c * 360 / summary.clusterCnt, 200, 220);
+		qreal const *centroid = summary.centroids.constData() + c * summary.axisCnt;
+		qreal const *low = summary.low.constData() + c * summary.axisCnt;
+		qreal const *high = summary.high.constData() + c * summary.axisCnt;
+
+		color.setAlpha(60);
+		painter.setPen(Qt::NoPen);
+		painter.setBrush(color);
+		for(int j=0; j+1<axis_data->count(); j++) {
+			axis_view_data const& a = (*axis_data)[j];
+			axis_view_data const& b = (*axis_data)[j+1];
+			if(b.x < rect.left() || a.x > rect.right())
+				continue;
+			if(qIsNaN(low[a.index]) || qIsNaN(low[b.index]))
+				continue;
+			QPolygonF band;
+			band << QPointF(a.x, canvasY(a.index, low[a.index]))
+				 << QPointF(b.x, canvasY(b.index, low[b.index]))
+				 << QPointF(b.x, canvasY(b.index, high[b.index]))
+				 << QPointF(a.x, canvasY(a.index, high[a.index]));
+			painter.drawPolygon(t.map(band));
+		}
+
+		color.setAlpha(255);
+		p.setColor(color);
+		painter.setPen(p);
+		QPolygonF line;
+		foreach(axis_view_data const& a, *axis_data) {
+			if(qIsNaN(centroid[a.index])) {
+				// gaps where no member has a value
+				if(line.count() > 1)
+					painter.drawPolyline(t.map(line));
+				line.clear();
+				continue;
+			}
+			line << QPointF(a.x, canvasY(a.index, centroid[a.index]));
+		}
+		if(line.count() > 1)
+			painter.drawPolyline(t.map(line));
+	}
+	painter.restore();
+}
+
+int QParallelCoordsWidget::clusterAt(QPoint viewportPos)
+{
+	// The cluster whose band holds the point between the two axes
+	// around it, the one with the nearest centroid line if several do
+	QRect r = visibleRect();
+	if(summary.axisCnt != data->axis_count() || r.isEmpty())
+		return -1;
+
+	QSizeF viewportSize = viewport()->size();
+	QTransform t;
+	t.scale(viewportSize.width()/r.width(),
+			viewportSize.height()/r.height());
+	t.translate(r.left() * -1, r.top() * -1);
+	QTransform inv = t.inverted();
+	QPointF pt = inv.map(QPointF(viewportPos));
+	qreal tolerance = inv.mapRect(QRectF(0, 0, 1, pickTolerance)).height();
+
+	int j = 0;
+	while(j+1 < axis_data->count() && (*axis_data)[j+1].x < pt.x())
+		j++;
+	if(j+1 >= axis_data->count() || (*axis_data)[j].x > pt.x())
+		return -1;
+	axis_view_data const& a = (*axis_data)[j];
+	axis_view_data const& b = (*axis_data)[j+1];
+	const qreal f = (pt.x() - a.x) / qMax(b.x - a.x, 1e-9);
+
+	auto canvasY = [&](int c, QVector<qreal> const& v)
+	{
+		QPair<qreal, qreal> ra = data->getRange(a.index);
+		QPair<qreal, qreal> rb = data->getRange(b.index);
+		qreal ya = (v[c * summary.axisCnt + a.index] - ra.first) *
+			canvas_size.height() / (ra.second - ra.first);
+		qreal yb = (v[c * summary.axisCnt + b.index] - rb.first) *
+			canvas_size.height() / (rb.second - rb.first);
+		return ya + (yb - ya) * f;
+	};
+
+	int best = -1;
+	qreal bestOut = tolerance, bestMid = 0;
+	for(int c=0; c<summary.clusterCnt; c++) {
+		qreal lo = canvasY(c, summary.low);
+		qreal hi = canvasY(c, summary.high);
+		qreal mid = canvasY(c, summary.centroids);
+		if(qIsNaN(lo) || qIsNaN(hi) || qIsNaN(mid))
+			continue;
+		if(lo > hi)
+			qSwap(lo, hi);
+		qreal out = qMax(qMax(lo - pt.y(), pt.y() - hi), 0.0);
+		qreal dist = qAbs(mid - pt.y());
+		if(out < bestOut || (out == bestOut && best >= 0 && dist < bestMid)) {
+			best = c;
+			bestOut = out;
+			bestMid = dist;
+		}
+	}
+	return best;
+}
+
 void QParallelCoordsWidget::mouseMoveEvent(QMouseEvent *event)
 {
-	if(!isAxisSelected)
+	if(summaryMode)
 		return;
+	if(!isAxisSelected) {
+		if(event->buttons() == Qt::NoButton)
+			pickAt(event->pos());
+		return;
+	}
 	if(!curveMode) {
 		axisMoveEngaged = true;
 		axisMovePos = event->pos();
@@ -290,16 +776,8 @@ void QParallelCoordsWidget::mouseReleaseEvent(QMouseEvent *event)
 			static_cast<double>(viewportSize.height())/curr_rect.height());
 		t.translate(curr_rect.left()*-1.0, curr_rect.top()*-1.0);
 
-		selectedAxis->pos.setX(t.inverted().map(event->pos()).x());
-		qSort(axis_data->begin(), axis_data->end(), 
-			[](axis_view_data a, axis_view_data b) 
-			{return a.pos.x() < b.pos.x();});
-
 		axisMoveEngaged = false;
-		isAxisSelected = false;
-
-		emit axisDataChange();
-		viewport()->update();
+		moveAxis(selectedAxis->index, t.inverted().map(event->pos()).x());
 	}
 	else if(rubberBand) {
 		isAxisSelected = false;
@@ -309,99 +787,175 @@ void QParallelCoordsWidget::mouseReleaseEvent(QMouseEvent *event)
 	}
 }
 
+void QParallelCoordsWidget::drawFrame(QPainter &painter, QRect r)
+{
+	if(curr_img.isNull())
+		return;
+	if(currImgValid) {
+		painter.drawImage(0, 0, curr_img);
+		drawBrush(painter, curr_rect);
+		return;
+	}
+
+	// The last frame stands in, moved and stretched to the current
+	// geometry. Nearest neighbour keeps this cheap, it is gone as
+	// soon as the exact frame is in.
+	QSizeF viewportSize = viewport()->size();
+	QTransform t;
+	t.scale(viewportSize.width()/r.width(),
+			viewportSize.height()/r.height());
+	t.translate(r.left() * -1, r.top() * -1);
+	QRectF target = t.mapRect(previewMap.mapRect(QRectF(curr_rect)));
+	painter.fillRect(viewport()->rect(), Qt::white);
+	painter.drawImage(target, curr_img);
+	drawBrush(painter, r);
+}
+
 void QParallelCoordsWidget::paintEvent(QPaintEvent *event)
 {
 	/* 
 	 * Check if we have a new image to draw. If so draw and return
-	 * If we have a valid current image then draw that on screen
-	 * If an axis was selected then update visuals and don't disable scrll brs
+	 * If we have a valid current image then draw that on screen,
+	 * otherwise the last one scaled to the current view
+	 * If an axis was selected then update visuals
+	 * Input is never held up, whatever changes while a tile renders
+	 * is asked for again once it is in
 	*/
 	Q_UNUSED(event);
 	if(data->axis_count() <= 0) return;
 
-	if(img != nullptr) {
+	QRect r = visibleRect();
+
+	// Summaries are drawn from the clusters alone, no rows rendered
+	if(summaryMode) {
 		QPainter painter;
-		{
-			bool stat = painter.begin(viewport());
-			Q_ASSERT(stat);
-		}
-		painter.drawImage(0, 0, *img);
+		painter.begin(viewport());
+		drawClusters(painter, r);
 		painter.end();
+		return;
+	}
+
+	if(img != nullptr) {
 		curr_img.swap(*img);
 		curr_rect = img_rect;
 		img_rect = QRect(0, 0, 0, 0);
+		delete img;
+		img = nullptr;
 
-		currImgValid = true;
+		// zooming or spacing may have gone on while it rendered
+		previewMap = requestMap;
+		currImgValid = previewMap.isIdentity() && curr_rect == r;
+		emit framePresented(frameClock.elapsed() - tileRequestMsecs,
+			tileRequestStale);
 
-		horizontalScrollBar()->setEnabled(true);
-		verticalScrollBar()->setEnabled(true);
+		QPainter painter;
+		{
+			bool stat = painter.begin(viewport());
+			Q_ASSERT(stat);
+		}
+		drawFrame(painter, r);
+		painter.end();
 
-		delete img;
-		img = nullptr;
+		if(tileRequestStale) {
+			tileRequestStale = false;
+			viewport()->update();
+		}
 		return;
 	}
 
-	if(currImgValid) {
-		if(isAxisSelected) {
-			QTransform t;
-			QSizeF viewportSize = viewport()->size();
-			t.scale(viewportSize.width()/curr_rect.width(),
-					viewportSize.height()/curr_rect.height());
-			t.translate(curr_rect.left() * -1, curr_rect.top() * -1);
-			QPoint screenPos = t.map(QPoint(selectedAxis->pos.x(), 
-											selectedAxis->pos.y()));
-
-			QRect before = QRect(0, 0, 
-				viewportSize.width(), viewportSize.height());
-			QRect after = before;
-			before.setRight(screenPos.x()-2);
-			after.setLeft(screenPos.x()+2);
-
-			QImage img(viewportSize.toSize(), 
-				QImage::Format_ARGB32_Premultiplied);
-			QPainter painter;
-			painter.begin(&img);
-			painter.drawImage(0, 0, curr_img);
-			QColor c(255,255,255, 95);
-			painter.fillRect(before, c);
-			painter.fillRect(after, c);
-
-			if(axisMoveEngaged) {
-				QPen p = painter.pen();
-				p.setWidthF(2);
-				p.setColor(QColor(0, 0, 255));
-				painter.setPen(p);
-				painter.drawLine(axisMovePos.x(), 0, 
-					axisMovePos.x(), viewportSize.height());
-			}
-			painter.end();
-
-			painter.begin(viewport());
-			painter.drawImage(0, 0, img);
-			painter.end();
-			return;
-		}
-		else {
-			QPainter painter;
-			painter.begin(viewport());
-			painter.drawImage(0, 0, curr_img);
-			painter.end();
+	currImgValid = !curr_img.isNull() && previewMap.isIdentity() &&
+		curr_rect == r;
+	if(currImgValid && isAxisSelected) {
+		QTransform t;
+		QSizeF viewportSize = viewport()->size();
+		t.scale(viewportSize.width()/curr_rect.width(),
+				viewportSize.height()/curr_rect.height());
+		t.translate(curr_rect.left() * -1, curr_rect.top() * -1);
+		QPoint screenPos = t.map(QPoint(selectedAxis->x, 0));
+
+		QRect before = QRect(0, 0, 
+			viewportSize.width(), viewportSize.height());
+		QRect after = before;
+		before.setRight(screenPos.x()-2);
+		after.setLeft(screenPos.x()+2);
+
+		QImage img(viewportSize.toSize(), 
+			QImage::Format_ARGB32_Premultiplied);
+		QPainter painter;
+		painter.begin(&img);
+		painter.drawImage(0, 0, curr_img);
+		QColor c(255,255,255, 95);
+		painter.fillRect(before, c);
+		painter.fillRect(after, c);
+
+		if(axisMoveEngaged) {
+			QPen p = painter.pen();
+			p.setWidthF(2);
+			p.setColor(QColor(0, 0, 255));
+			painter.setPen(p);
+			painter.drawLine(axisMovePos.x(), 0, 
+				axisMovePos.x(), viewportSize.height());
 		}
+		painter.end();
+
+		painter.begin(viewport());
+		painter.drawImage(0, 0, img);
+		painter.end();
+		return;
 	}
 
-	QRect r(horizontalScrollBar()->value(),
-			verticalScrollBar()->value(),
-			canvas_size.width() * scale_x,
-			canvas_size.height() * scale_y);
+	{
+		QPainter painter;
+		painter.begin(viewport());
+		drawFrame(painter, r);
+		painter.end();
+	}
 
+	// One request at a time, anything asked for meanwhile is
+	// requested again once the pending tile has arrived
+	if(tileRequested) {
+		// A want waiting behind it is dropped once a different one
+		// takes its place, repaints of the same want drop nothing
+		if(tileRequestStale && (r != staleRect || viewVersion != staleVersion))
+			emit frameDropped();
+		tileRequestStale = true;
+		staleRect = r;
+		staleVersion = viewVersion;
+		return;
+	}
+	tileRequested = true;
+	tileRequestMsecs = frameClock.elapsed();
+	requestMap.reset();
 	emit requestTile(r);
-	horizontalScrollBar()->setEnabled(false);
-	verticalScrollBar()->setEnabled(false);
 }
 
 void QParallelCoordsWidget::renderTile(QRect r, QImage *img_)
 { 
+	tileRequested = false;
+	if(img)
+		emit frameDropped();
+	delete img;
 	img = img_;
 	img_rect = r;
 	viewport()->update();
+}
+
+void QParallelCoordsWidget::refreshTile(QRect r, QImage *img_)
+{
+	// Answers no request, a request in flight is still answered by
+	// renderTile. Replaces the frame of r on screen or still waiting
+	// to be drawn.
+	if(img != nullptr && img_rect == r) {
+		delete img;
+		img = img_;
+	}
+	else if(img == nullptr && curr_rect == r) {
+		curr_img.swap(*img_);
+		delete img_;
+	}
+	else {
+		delete img_;
+		return;
+	}
+	viewport()->update();
 }
\ No newline at end of file
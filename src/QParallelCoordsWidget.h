@@ -5,7 +5,10 @@
 #include "ParallelCoordinates.h"
 #include "QParallelCoordsData.h"
 #include "ParallelCoordsViewPrivate.h"
-#include "ParallelCoordsRenderThread.h"
+#include "ParallelCoordsRenderService.h"
+#include "ParallelCoordsPosterExport.h"
+#include "ParallelCoordsClustering.h"
+#include "ParallelCoordsTrace.h"
 
 class QParallelCoordsWidget : public QAbstractScrollArea
 {
@@ -26,14 +29,41 @@ public:
 	qreal getYScale() const;
 	void setCurveMode(bool state);
 	bool getCurveMode();
+	QSize getCanvasSize() const;
+	// Export of the current layout, the caller starts it
+	ParallelCoordsPosterExport* createPosterExport(QObject *parent) const;
+	// Interactions are recorded into trace while it is recording,
+	// nullptr stops recording
+	void setTrace(ParallelCoordsTrace *trace);
+	// Applies a recorded interaction as if the user had made it
+	void replay(ParallelCoordsTrace::event const& e);
+	// Moves the axis with data index idx to canvas position x
+	void moveAxis(int idx, qreal x);
+	// No tile requested and none waiting to be drawn
+	bool isIdle() const;
+	// Only the rows in mask are drawn, nullptr draws them all
+	void setRowMask(ParallelCoordsRowMask mask);
 
 signals:
 	void requestTile(QRect r);
-	void scaleFactorsChange(QPair<qreal, qreal> f);
+	// Device pixels per canvas unit
+	void densityChange(QPair<qreal, qreal> density);
 	void viewportSizeChange(QSize viewportSize);
 	void canvasSizeChange(QSize canvasSize);
 	void axisDataChange();
+	void rowMaskChange();
+	void memoryLimitChange(qint64 bytes);
 	void axisSelected(int idx);
+	void requestPick(QPointF pt, qreal tolerance);
+	void rowsPicked(QVector<int> rows);
+	// A tile reached the screen latencyMsecs after it was requested.
+	// Stale frames were already outdated by later interaction.
+	void framePresented(qint64 latencyMsecs, bool stale);
+	// A frame never reached the screen, a later one took its place
+	// before it was requested or before it was drawn
+	void frameDropped();
+	// A cluster of the summary was clicked, its rows are shown now
+	void clusterOpened(int cluster, int rows);
 
 public slots:
 	void setXScale(int scale);
@@ -43,32 +73,87 @@ public slots:
 	void setXScale(qreal scale);
 	void setYScale(qreal scale);
 	void renderTile(QRect r, QImage *img);
+	void refreshTile(QRect r, QImage *img);
+	void pickResult(QPointF pt, QVector<int> rows);
+	// Rows highlighted in every view of the data
+	void setBrushedRows(QVector<int> rows);
 	void updateView(bool doLayout_ = false);
 	void updateLayout();
+	void reorderAxes();
+	// In summary mode the clusters are drawn instead of the rows and
+	// a click on one shows its rows
+	void setSummaryMode(bool on);
+	void setClusterSummary(ParallelCoordsClusterSummary summary);
+	void showAllRows();
+	// Bytes of data a render may hold at once, shared by the tiles
+	// rendered together
+	void setMemoryLimit(int megabytes);
 
 private:
-	ParallelCoordsRenderThread *renderThread;
+	ParallelCoordsRenderService *renderService;
 	ParallelCoordsRenderManager *renderManager;
 	QParallelCoordsData const *data;
 	QSize canvas_size;
 	qreal inter_axis_width, axis_box_width;
 	qreal scale_x, scale_y;
+	qreal density_x, density_y;
 	QImage *img;
 	QRect img_rect;
 	QImage curr_img;
 	QRect curr_rect;
-	bool currImgValid;
+	bool currImgValid;			// curr_img is exactly what is on screen
+	// Canvas coordinates of curr_img and of the pending tile to the
+	// current ones. Until the exact frame arrives the last one is
+	// shown moved and stretched to where its content is now.
+	QTransform previewMap;
+	QTransform requestMap;
 	bool isAxisSelected;
 	bool axisMoveEngaged;
 	bool curveMode;
 	QPoint axisMovePos;
+	bool tileRequested;
+	bool tileRequestStale;
+	// What the want waiting behind a request was for, the version is
+	// bumped whenever the rendered frame changes at the same rect
+	QRect staleRect;
+	quint32 staleVersion;
+	quint32 viewVersion;
+	QElapsedTimer frameClock;
+	qint64 tileRequestMsecs;
+	ParallelCoordsTrace *trace;
+	bool pickPending;
+	bool pickQueued;
+	QPoint pickPos;
+	int pickTolerance;
+	QVector<int> brushedRows;
 	QRubberBand *rubberBand;
+	bool summaryMode;
+	ParallelCoordsClusterSummary summary;
+	int openedCluster;
+	QFutureWatcher<ParallelCoordsRowMask> *memberWatcher;
+	qint64 memoryLimit;			// bytes, handed to the renderers
 
-	QList<axis_view_data>::iterator selectedAxis; 
+	QVector<axis_view_data>::iterator selectedAxis; 
 
-	QList<axis_view_data> *axis_data;
+	QVector<axis_view_data> *axis_data;
+	QFutureWatcher<QVector<int>> *reorderWatcher;
 	void doLayout();
+	void publishLayout();
 	void setup_scrollbar();
+	void updateDensity();
+	QSizeF visibleExtent() const;
+	QRect visibleRect() const;
+	void mapPreview(qreal oldPitch, qreal oldBoxWidth);
+	void drawFrame(QPainter &painter, QRect r);
+	void pickAt(QPoint viewportPos);
+	void drawBrush(QPainter &painter, QRect rect);
+	void drawClusters(QPainter &painter, QRect rect);
+	int clusterAt(QPoint viewportPos);
+
+private slots:
+	void applyAxisOrder();
+	void applyMembers();
+	void filterChange();
 
 protected:
 	void paintEvent(QPaintEvent *event);
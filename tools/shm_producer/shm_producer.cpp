@@ -0,0 +1,113 @@
+// Fills a shared memory segment with random walk rows the way a
+// simulation would, a batch at a time.
+//
+//   shm_producer <name> <axes> <rows> [batch rows] [msecs between batches]
+//
+// Attach the visualizer to <name> while it runs. The segment is left
+// behind for later viewers, it goes away with the next run of the same
+// name or a reboot.
+
+#include "ParallelCoordsShmLayout.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <string>
+#include <vector>
+
+static int64_t nowMsecs()
+{
+	struct timeval tv;
+	gettimeofday(&tv, nullptr);
+	return static_cast<int64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 4) {
+		fprintf(stderr, "usage: %s <name> <axes> <rows> "
+			"[batch rows] [msecs between batches]\n", argv[0]);
+		return 1;
+	}
+	const std::string name = std::string("/") + argv[1];
+	const int axisCnt = atoi(argv[2]);
+	const int64_t rowCnt = atoll(argv[3]);
+	const int64_t batchRows = argc > 4 ? atoll(argv[4]) : 10000;
+	const int pauseMsecs = argc > 5 ? atoi(argv[5]) : 50;
+	if(axisCnt <= 0 || rowCnt <= 0 || batchRows <= 0) {
+		fprintf(stderr, "axes, rows and batch rows have to be positive\n");
+		return 1;
+	}
+
+	// header and names, then 64 byte aligned columns
+	const int64_t namesEnd = sizeof(ParallelCoordsShmHeader) +
+		static_cast<int64_t>(axisCnt) * parallelCoordsShmNameBytes;
+	const int64_t dataOffset = (namesEnd + 63) & ~static_cast<int64_t>(63);
+	const int64_t size = dataOffset + 
+		static_cast<int64_t>(axisCnt) * rowCnt * sizeof(double);
+
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0 || ftruncate(fd, size) != 0) {
+		perror("shm_open");
+		return 1;
+	}
+	void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	ParallelCoordsShmHeader *header = new (base) ParallelCoordsShmHeader;
+	header->magic = parallelCoordsShmMagic;
+	header->version = parallelCoordsShmVersion;
+	header->axisCnt = axisCnt;
+	header->nameBytes = parallelCoordsShmNameBytes;
+	header->capacity = rowCnt;
+	header->dataOffset = dataOffset;
+	header->createdMsecs = nowMsecs();
+	header->published.store(0, std::memory_order_relaxed);
+	header->closed.store(0, std::memory_order_relaxed);
+
+	char *names = static_cast<char*>(base) + sizeof(ParallelCoordsShmHeader);
+	for(int i=0; i<axisCnt; i++) {
+		snprintf(names + i * parallelCoordsShmNameBytes,
+			parallelCoordsShmNameBytes, "axis %d", i);
+	}
+	double *columns = reinterpret_cast<double*>(
+		static_cast<char*>(base) + dataOffset);
+
+	// correlated random walks, every axis follows the one before a bit
+	std::vector<double> walk(axisCnt, 0.0);
+	srand(static_cast<unsigned>(header->createdMsecs));
+	for(int64_t first=0; first<rowCnt; first+=batchRows) {
+		const int64_t last = first + batchRows < rowCnt ? first + batchRows : rowCnt;
+		for(int64_t r=first; r<last; r++) {
+			for(int i=0; i<axisCnt; i++) {
+				double step = rand() / static_cast<double>(RAND_MAX) - 0.5;
+				walk[i] += step + (i > 0 ? 0.1 * (walk[i-1] - walk[i]) : 0.0);
+				columns[i * rowCnt + r] = std::fabs(walk[i]) * 10.0;
+			}
+		}
+
+		// values first, then the count that makes them visible
+		header->published.store(last, std::memory_order_release);
+		printf("published %lld rows\n", static_cast<long long>(last));
+		fflush(stdout);
+
+		struct timespec pause = {pauseMsecs / 1000, (pauseMsecs % 1000) * 1000000L};
+		nanosleep(&pause, nullptr);
+	}
+	header->closed.store(1, std::memory_order_release);
+
+	munmap(base, size);
+	return 0;
+}
@@ -0,0 +1,13 @@
+######################################################################
+# Test producer for the shared memory ingestion of the visualizer
+######################################################################
+CONFIG += console
+CONFIG -= qt app_bundle
+TEMPLATE = app
+TARGET = shm_producer
+INCLUDEPATH += ../../src
+unix:!macx:LIBS += -lrt
+
+# Input
+HEADERS += ../../src/ParallelCoordsShmLayout.h
+SOURCES += shm_producer.cpp